@@ -23,11 +23,7 @@ main(int argc, char *argv[])
   int day;
   struct rtcdate r;
 
-  if (date(&r)) {
-    printf(2,"Error: date call failed. %s at line %d\n",
-        __FILE__, __LINE__);
-    exit();
-  }
+  vdate(&r);
 
   day = dayofweek(r.year, r.month, r.day);
 
@@ -2,14 +2,23 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct logstat;
+struct iovec;
 struct pipe;
 struct proc;
 struct rtcdate;
 struct spinlock;
 struct sleeplock;
+struct rwlock;
+struct slabcache;
+struct slabinfo;
+struct membench;
+struct lockstat;
 struct stat;
 struct superblock;
 struct uproc;
+struct cputime;
+struct schedevent;
 
 // bio.c
 void binit(void);
@@ -33,21 +42,33 @@ int exec(char *, char **);
 struct file *filealloc(void);
 void fileclose(struct file *);
 struct file *filedup(struct file *);
+struct file *fileget(struct file **);
 void fileinit(void);
 int fileread(struct file *, char *, int n);
+int filereadv(struct file *, struct iovec *, int, int);
 int filestat(struct file *, struct stat *);
 int filewrite(struct file *, char *, int n);
+int filewritev(struct file *, struct iovec *, int, int);
+
+// futex.c
+void futexinit(void);
+int futexwait(uint, uint);
+int futexwake(uint, int);
 
 // fs.c
 void readsb(int dev, struct superblock *sb);
 int dirlink(struct inode *, char *, uint);
+uint dirfind(struct inode *, char *, uint *);
 struct inode *dirlookup(struct inode *, char *, uint *);
 struct inode *ialloc(uint, short);
 struct inode *idup(struct inode *);
+struct inode *iget(uint, uint);
 void iinit(int dev);
 void ilock(struct inode *);
+void ilockshared(struct inode *);
 void iput(struct inode *);
 void iunlock(struct inode *);
+void iunlockshared(struct inode *);
 void iunlockput(struct inode *);
 void iupdate(struct inode *);
 int namecmp(const char *, const char *);
@@ -82,6 +103,7 @@ int lapicid(void);
 extern volatile uint *lapic;
 void lapiceoi(void);
 void lapicinit(void);
+void lapicipi(int, int);
 void lapicstartap(uchar, uint);
 void microdelay(int);
 
@@ -89,7 +111,10 @@ void microdelay(int);
 void initlog(int dev);
 void log_write(struct buf *);
 void begin_op();
+int begin_opn(int);
 void end_op();
+void end_opn(int);
+void logstat(struct logstat *);
 
 // mp.c
 extern int ismp;
@@ -107,20 +132,29 @@ int pipewrite(struct pipe *, char *, int);
 
 //PAGEBREAK: 16
 // proc.c
+int clone(void (*)(void *, void *), void *, void *, void *);
 int cpuid(void);
+void endthreads(struct proc *);
 void exit(void);
 int fork(void);
+int getaffinity(int);
 int growproc(int);
+int join(void **);
 int kill(int);
 struct cpu *mycpu(void);
 struct proc *myproc();
+int needresched(void);
 void pinit(void);
+struct file **procfiles(struct proc *);
 void procdump(void);
+int setaffinity(int, uint);
 void scheduler(void) __attribute__((noreturn));
 void sched(void);
 void setproc(struct proc *);
 void sleep(void *, struct spinlock *);
 void userinit(void);
+void uvmenter(void);
+void uvmleave(void);
 int wait(void);
 void wakeup(void *);
 void yield(void);
@@ -128,6 +162,7 @@ void yield(void);
 int setuid(int *);
 int setgid(int *);
 int getprocs(uint, struct uproc *);
+int cputime(struct cputime *);
 #endif
 #ifdef CS333_P3
 void runnabledump(void);
@@ -138,8 +173,20 @@ void zombiedump(void);
 #ifdef CS333_P4
 int setpriority(int pid, int priority);
 int getpriority(int pid);
+int setscheduler(int policy);
+int setshare(uint, int);
+int setdeadline(int, int);
+int rtwait(void);
+int rtpreempt(struct proc *);
+void sleeplockwait(struct sleeplock *);
+void sleeplockunboost(void);
 #endif
 
+// schedtrace.c
+void schedtraceinit(void);
+void schedlog(int, struct proc *, int);
+int schedtrace(struct schedevent *, int);
+
 // swtch.S
 void swtch(struct context **, struct context *);
 
@@ -148,18 +195,40 @@ void acquire(struct spinlock *);
 void getcallerpcs(void *, uint *);
 int holding(struct spinlock *);
 void initlock(struct spinlock *, char *);
+int lockstat(struct lockstat *, int);
 void release(struct spinlock *);
 void pushcli(void);
 void popcli(void);
 
+// slab.c
+void slabinit(struct slabcache *, char *, uint);
+void *slaballoc(struct slabcache *);
+void slabfree(struct slabcache *, void *);
+void kmallocinit(void);
+void *kmalloc(uint);
+void kmfree(void *);
+int slabinfo(struct slabinfo *, int);
+
+// rwlock.c
+void initrwlock(struct rwlock *, char *);
+void acquireread(struct rwlock *);
+void releaseread(struct rwlock *);
+void acquirewrite(struct rwlock *);
+void releasewrite(struct rwlock *);
+
 // sleeplock.c
 void acquiresleep(struct sleeplock *);
 void releasesleep(struct sleeplock *);
 int holdingsleep(struct sleeplock *);
 void initsleeplock(struct sleeplock *, char *);
+void acquiresleepshared(struct sleeplock *);
+void releasesleepshared(struct sleeplock *);
 
 // string.c
+extern int sse2;
+void stringinit(void);
 int memcmp(const void *, const void *, uint);
+int membench(struct membench *);
 void *memmove(void *, const void *, uint);
 void *memset(void *, int, uint);
 char *safestrcpy(char *, const char *, int);
@@ -181,6 +250,9 @@ void timerinit(void);
 // trap.c
 void idtinit(void);
 extern uint ticks;
+extern uint tscpertick;
+extern int sysenter;
+void sysenterinit(void);
 void tvinit(void);
 
 // uart.c
@@ -195,6 +267,9 @@ pde_t *setupkvm(void);
 char *uva2ka(pde_t *, char *);
 int allocuvm(pde_t *, uint, uint);
 int deallocuvm(pde_t *, uint, uint);
+int shrinkuvm(pde_t *, uint, uint);
+void tlbshootdown(pde_t *);
+void tlbflushintr(void);
 void freevm(pde_t *);
 void inituvm(pde_t *, char *, uint);
 int loaduvm(pde_t *, char *, struct inode *, uint, uint);
@@ -203,6 +278,9 @@ void switchuvm(struct proc *);
 void switchkvm(void);
 int copyout(pde_t *, uint, void *, uint);
 void clearpteu(pde_t *pgdir, char *uva);
+void vdsoinit(void);
+void vdsotick(int);
+void setvdsopid(pde_t *, int);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x) / sizeof((x)[0]))
@@ -7,6 +7,18 @@
 #include "x86.h"
 #include "elf.h"
 
+// Start the new image with clean x87/SSE registers, as after
+// fninit and with MXCSR at its reset value, not the old image's.
+static void
+fpureset(struct proc *p)
+{
+  char *fx = FPUSTATE(p);
+
+  memset(fx, 0, 512);
+  *(ushort*)fx = 0x37f;         // FCW
+  *(uint*)(fx + 24) = 0x1f80;   // MXCSR
+  fxrstor(fx);
+}
 
 int
 exec(char *path, char **argv)
@@ -20,6 +32,10 @@ exec(char *path, char **argv)
   pde_t *pgdir, *oldpgdir;
   struct proc *curproc = myproc();
 
+  // Only the thread that owns the memory may replace it.
+  if(curproc->thread)
+    return -1;
+
   begin_op();
 
   if((ip = namei(path)) == 0){
@@ -40,6 +56,7 @@ exec(char *path, char **argv)
 
   if((pgdir = setupkvm()) == 0)
     goto bad;
+  setvdsopid(pgdir, curproc->pid);
 
   // Load program into memory.
   sz = 0;
@@ -97,11 +114,14 @@ exec(char *path, char **argv)
   safestrcpy(curproc->name, last, sizeof(curproc->name));
 
   // Commit to the user image.
+  endthreads(curproc);
   oldpgdir = curproc->pgdir;
   curproc->pgdir = pgdir;
   curproc->sz = sz;
   curproc->tf->eip = elf.entry;  // main
   curproc->tf->esp = sp;
+  if(sse2)
+    fpureset(curproc);
   switchuvm(curproc);
   freevm(oldpgdir);
   return 0;
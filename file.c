@@ -5,21 +5,27 @@
 #include "types.h"
 #include "defs.h"
 #include "param.h"
+#include "stat.h"
 #include "fs.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "uio.h"
+#include "slab.h"
 
 struct devsw devsw[NDEV];
 struct {
   struct spinlock lock;
-  struct file file[NFILE];
+  int nfile;          // open file structures
 } ftable;
 
+static struct slabcache filecache;
+
 void
 fileinit(void)
 {
   initlock(&ftable.lock, "ftable");
+  slabinit(&filecache, "file", sizeof(struct file));
 }
 
 // Allocate a file structure.
@@ -29,15 +35,21 @@ filealloc(void)
   struct file *f;
 
   acquire(&ftable.lock);
-  for(f = ftable.file; f < ftable.file + NFILE; f++){
-    if(f->ref == 0){
-      f->ref = 1;
-      release(&ftable.lock);
-      return f;
-    }
+  if(ftable.nfile >= NFILE){
+    release(&ftable.lock);
+    return 0;
   }
+  ftable.nfile++;
   release(&ftable.lock);
-  return 0;
+
+  if((f = slaballoc(&filecache)) == 0){
+    acquire(&ftable.lock);
+    ftable.nfile--;
+    release(&ftable.lock);
+    return 0;
+  }
+  f->ref = 1;
+  return f;
 }
 
 // Increment ref count for file f.
@@ -52,6 +64,20 @@ filedup(struct file *f)
   return f;
 }
 
+// Take a reference to the file in *slot, which another thread
+// may be emptying, or return 0 if it is already empty.
+struct file*
+fileget(struct file **slot)
+{
+  struct file *f;
+
+  acquire(&ftable.lock);
+  if((f = *slot) != 0)
+    f->ref++;
+  release(&ftable.lock);
+  return f;
+}
+
 // Close file f.  (Decrement ref count, close when reaches 0.)
 void
 fileclose(struct file *f)
@@ -66,9 +92,9 @@ fileclose(struct file *f)
     return;
   }
   ff = *f;
-  f->ref = 0;
-  f->type = FD_NONE;
+  ftable.nfile--;
   release(&ftable.lock);
+  slabfree(&filecache, f);
 
   if(ff.type == FD_PIPE)
     pipeclose(ff.pipe, ff.writable);
@@ -92,66 +118,167 @@ filestat(struct file *f, struct stat *st)
   return -1;
 }
 
-// Read from file f.
+// Read from file f into the buffers described by iov.
+// If off is negative, read at and advance the file's shared
+// offset; otherwise read at off and leave f->off alone (pread).
+// Stops early on a short read, like a single read() would.
 int
-fileread(struct file *f, char *addr, int n)
+filereadv(struct file *f, struct iovec *iov, int iovcnt, int off)
 {
-  int r;
+  int i, r, tot, shared;
+  uint o;
 
   if(f->readable == 0)
     return -1;
-  if(f->type == FD_PIPE)
-    return piperead(f->pipe, addr, n);
+  if(f->type == FD_PIPE){
+    if(off >= 0)
+      return -1;  // pipes have no offset to seek to
+    tot = 0;
+    for(i = 0; i < iovcnt; i++){
+      if(iov[i].iov_len == 0)
+        continue;
+      if((r = piperead(f->pipe, iov[i].iov_base, iov[i].iov_len)) < 0)
+        return tot > 0 ? tot : -1;
+      tot += r;
+      if(r < iov[i].iov_len)
+        break;
+    }
+    return tot;
+  }
   if(f->type == FD_INODE){
-    ilock(f->ip);
-    if((r = readi(f->ip, addr, f->off, n)) > 0)
-      f->off += r;
-    iunlock(f->ip);
-    return r;
+    tot = 0;
+    r = 0;
+    // Share the inode with other readers unless we must update an
+    // f->off that another descriptor could also be using, or read
+    // a device, whose read function may unlock the inode.
+    shared = off >= 0 || f->ref == 1;
+    if(shared){
+      ilockshared(f->ip);
+      if(f->ip->type == T_DEV){
+        iunlockshared(f->ip);
+        shared = 0;
+      }
+    }
+    if(!shared)
+      ilock(f->ip);
+    o = off < 0 ? f->off : off;
+    for(i = 0; i < iovcnt; i++){
+      if(iov[i].iov_len == 0)
+        continue;
+      // readi() rejects offsets past the end; that is just EOF.
+      if(f->ip->type != T_DEV && o >= f->ip->size)
+        break;
+      if((r = readi(f->ip, iov[i].iov_base, o, iov[i].iov_len)) < 0)
+        break;
+      o += r;
+      tot += r;
+      if(r < iov[i].iov_len)
+        break;
+    }
+    if(off < 0)
+      f->off = o;
+    if(shared)
+      iunlockshared(f->ip);
+    else
+      iunlock(f->ip);
+    return r < 0 && tot == 0 ? -1 : tot;
   }
-  panic("fileread");
+  panic("filereadv");
+}
+
+// Read from file f.
+int
+fileread(struct file *f, char *addr, int n)
+{
+  struct iovec iov;
+
+  iov.iov_base = addr;
+  iov.iov_len = n;
+  return filereadv(f, &iov, 1, -1);
 }
 
 //PAGEBREAK!
-// Write to file f.
+// Write the buffers described by iov to file f.
+// A negative off means the file's shared offset, as for filereadv().
 int
-filewrite(struct file *f, char *addr, int n)
+filewritev(struct file *f, struct iovec *iov, int iovcnt, int off)
 {
-  int r;
+  int i, r, tot;
 
   if(f->writable == 0)
     return -1;
-  if(f->type == FD_PIPE)
-    return pipewrite(f->pipe, addr, n);
+  if(f->type == FD_PIPE){
+    if(off >= 0)
+      return -1;
+    tot = 0;
+    for(i = 0; i < iovcnt; i++){
+      if((r = pipewrite(f->pipe, iov[i].iov_base, iov[i].iov_len)) < 0)
+        return -1;
+      tot += r;
+    }
+    return tot;
+  }
   if(f->type == FD_INODE){
-    // write a few blocks at a time to avoid exceeding
-    // the maximum log transaction size, including
-    // i-node, indirect block, allocation blocks,
-    // and 2 blocks of slop for non-aligned writes.
-    // this really belongs lower down, since writei()
-    // might be writing a device like the console.
-    int max = ((MAXOPBLOCKS-1-1-2) / 2) * 512;
-    int i = 0;
-    while(i < n){
-      int n1 = n - i;
-      if(n1 > max)
-        n1 = max;
-
-      begin_op();
+    // write as many blocks at a time as the log has room
+    // for, without exceeding the maximum log transaction
+    // size: each data block may also dirty a bitmap block,
+    // plus the i-node, the indirect block, and 2 blocks of
+    // slop for non-aligned writes. this really belongs lower
+    // down, since writei() might be writing a device like
+    // the console. the bytes of consecutive iovecs land
+    // contiguously in the file, so one transaction covers
+    // as many iovecs as fit in it.
+    int done = 0;  // bytes of iov[i] already written
+    int n, n1, nblk, max;
+    uint o;
+
+    n = 0;
+    for(i = 0; i < iovcnt; i++)
+      n += iov[i].iov_len;
+    tot = 0;
+    r = 0;
+    i = 0;
+    while(i < iovcnt){
+      nblk = begin_opn(((n - tot + BSIZE-1) / BSIZE) * 2 + 1 + 1 + 2);
+      max = ((nblk-1-1-2) / 2) * BSIZE;
       ilock(f->ip);
-      if ((r = writei(f->ip, addr + i, f->off, n1)) > 0)
-        f->off += r;
+      o = off < 0 ? f->off : off + tot;
+      for(; i < iovcnt && max > 0; max -= r){
+        n1 = iov[i].iov_len - done;
+        if(n1 > max)
+          n1 = max;
+        if((r = writei(f->ip, (char*)iov[i].iov_base + done, o, n1)) < 0)
+          break;
+        if(r != n1)
+          panic("short filewrite");
+        o += r;
+        tot += r;
+        done += r;
+        if(done == iov[i].iov_len){
+          i++;
+          done = 0;
+        }
+      }
+      if(off < 0)
+        f->off = o;
       iunlock(f->ip);
-      end_op();
+      end_opn(nblk);
 
       if(r < 0)
-        break;
-      if(r != n1)
-        panic("short filewrite");
-      i += r;
+        return -1;
     }
-    return i == n ? n : -1;
+    return tot;
   }
-  panic("filewrite");
+  panic("filewritev");
 }
 
+// Write to file f.
+int
+filewrite(struct file *f, char *addr, int n)
+{
+  struct iovec iov;
+
+  iov.iov_base = addr;
+  iov.iov_len = n;
+  return filewritev(f, &iov, 1, -1);
+}
@@ -0,0 +1,123 @@
+// Futexes: sleep and wake on a word of user memory.
+//
+// A futex is named by the kernel address of the user word, so
+// threads sharing a page table (and any other mappings of the
+// same page) agree on it. Waiters queue on a small hash table;
+// the user-level fast paths in uthread.c only come here when a
+// lock or condition is actually contended.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+
+#define NFUTEX 64
+
+struct futexq {
+  struct spinlock lock;
+  struct proc *head;  // waiters, oldest first, linked by fnext
+};
+
+static struct futexq futexq[NFUTEX];
+
+void
+futexinit(void)
+{
+  int i;
+
+  for(i = 0; i < NFUTEX; i++)
+    initlock(&futexq[i].lock, "futex");
+}
+
+static struct futexq*
+futexbucket(uint *key)
+{
+  return &futexq[((uint)key >> 2) % NFUTEX];
+}
+
+// Kernel address of the aligned user word at uva, or 0.
+static uint*
+futexkey(uint uva)
+{
+  struct proc *curproc = myproc();
+  char *ka;
+
+  if(uva % sizeof(uint) || uva >= curproc->sz)
+    return 0;
+  if((ka = uva2ka(curproc->pgdir, (char*)PGROUNDDOWN(uva))) == 0)
+    return 0;
+  return (uint*)(ka + uva % PGSIZE);
+}
+
+// If the word at uva still holds val, sleep until futexwake()
+// on the same word. Returns 0 when woken, -1 if the word had
+// changed, the address is bad, or the process was killed.
+int
+futexwait(uint uva, uint val)
+{
+  struct proc *curproc = myproc();
+  struct proc **pp;
+  struct futexq *q;
+  uint *key;
+
+  if((key = futexkey(uva)) == 0)
+    return -1;
+  q = futexbucket(key);
+  acquire(&q->lock);
+  // futexwake() takes q->lock too, so a store plus wake that
+  // follows this check cannot be lost.
+  if(*(volatile uint*)key != val){
+    release(&q->lock);
+    return -1;
+  }
+  curproc->futex = key;
+  curproc->fnext = 0;
+  for(pp = &q->head; *pp; pp = &(*pp)->fnext)
+    ;
+  *pp = curproc;
+  while(curproc->futex && !curproc->killed)
+    sleep(&curproc->futex, &q->lock);
+  if(curproc->futex){
+    // Killed while still queued.
+    for(pp = &q->head; *pp != curproc; pp = &(*pp)->fnext)
+      ;
+    *pp = curproc->fnext;
+    curproc->futex = 0;
+    release(&q->lock);
+    return -1;
+  }
+  release(&q->lock);
+  return 0;
+}
+
+// Wake up to n waiters on the word at uva, oldest first.
+// Returns how many were woken, or -1 for a bad address.
+int
+futexwake(uint uva, int n)
+{
+  struct proc *p, **pp;
+  struct futexq *q;
+  uint *key;
+  int woken;
+
+  if((key = futexkey(uva)) == 0)
+    return -1;
+  q = futexbucket(key);
+  woken = 0;
+  acquire(&q->lock);
+  pp = &q->head;
+  while((p = *pp) != 0 && woken < n){
+    if(p->futex != key){
+      pp = &p->fnext;
+      continue;
+    }
+    *pp = p->fnext;
+    p->futex = 0;
+    wakeup(&p->futex);
+    woken++;
+  }
+  release(&q->lock);
+  return woken;
+}
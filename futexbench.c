@@ -0,0 +1,99 @@
+// Compare spin locks with futex mutexes as the number of
+// contending threads grows, and time a condition variable
+// ping-pong between two threads.
+
+#include "types.h"
+#include "user.h"
+
+#define N 100000
+#define PINGS 10000
+
+lock_t spin;
+mutex_t mutex;
+cond_t cond;
+int count;
+int turn;
+int nthread;
+
+void
+spinworker(void *arg1, void *arg2)
+{
+  int i;
+
+  for(i = 0; i < N / nthread; i++){
+    lock_acquire(&spin);
+    count++;
+    lock_release(&spin);
+  }
+  exit();
+}
+
+void
+mutexworker(void *arg1, void *arg2)
+{
+  int i;
+
+  for(i = 0; i < N / nthread; i++){
+    mutex_lock(&mutex);
+    count++;
+    mutex_unlock(&mutex);
+  }
+  exit();
+}
+
+// Wait for turn to be arg1, then hand it to the other thread.
+void
+pingworker(void *arg1, void *arg2)
+{
+  int i;
+
+  for(i = 0; i < PINGS; i++){
+    mutex_lock(&mutex);
+    while(turn != (int)arg1)
+      cond_wait(&cond, &mutex);
+    turn = !turn;
+    cond_broadcast(&cond);
+    mutex_unlock(&mutex);
+  }
+  exit();
+}
+
+int
+run(void (*fcn)(void*, void*))
+{
+  int i, t0;
+
+  count = 0;
+  t0 = uptime();
+  for(i = 0; i < nthread; i++)
+    if(thread_create(fcn, (void*)i, 0) < 0){
+      printf(2, "futexbench: thread_create failed\n");
+      exit();
+    }
+  for(i = 0; i < nthread; i++)
+    thread_join();
+  if(count != N / nthread * nthread && fcn != pingworker)
+    printf(2, "futexbench: counted %d\n", count);
+  return uptime() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int spint;
+
+  lock_init(&spin);
+  mutex_init(&mutex);
+  cond_init(&cond);
+
+  printf(1, "%d increments\nthreads\tspin\tmutex\n", N);
+  for(nthread = 1; nthread <= 8; nthread *= 2){
+    spint = run(spinworker);
+    printf(1, "%d\t%d\t%d\n", nthread, spint, run(mutexworker));
+  }
+
+  nthread = 2;
+  turn = 0;
+  printf(1, "%d condvar round trips: %d ticks\n", PINGS, run(pingworker));
+  exit();
+}
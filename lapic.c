@@ -124,6 +124,21 @@ microdelay(int us)
 {
 }
 
+// Send an interrupt with vector to the CPU whose local APIC
+// has apicid.
+void
+lapicipi(int apicid, int vector)
+{
+  if(!lapic)
+    return;
+  pushcli();  // ICRHI and ICRLO go together
+  lapicw(ICRHI, apicid<<24);
+  lapicw(ICRLO, FIXED | ASSERT | vector);
+  while(lapic[ICRLO] & DELIVS)
+    ;
+  popcli();
+}
+
 #define CMOS_PORT    0x70
 #define CMOS_RETURN  0x71
 
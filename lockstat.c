@@ -0,0 +1,56 @@
+// Print spin lock statistics, merging locks with the same name
+// (such as the buffer cache's "sleep lock"s), most spinning first.
+
+#include "types.h"
+#include "user.h"
+#include "lockstat.h"
+
+struct lockstat ls[NLOCKSTAT];
+
+int
+main(int argc, char *argv[])
+{
+  struct lockstat t;
+  int i, j, n, m;
+
+  if((n = lockstat(ls, NLOCKSTAT)) < 0){
+    printf(2, "lockstat: lockstat failed\n");
+    exit();
+  }
+
+  // Merge entries with the same name into the first one.
+  m = 0;
+  for(i = 0; i < n; i++){
+    for(j = 0; j < m; j++)
+      if(strcmp(ls[j].name, ls[i].name) == 0)
+        break;
+    if(j == m){
+      ls[m++] = ls[i];
+      continue;
+    }
+    ls[j].nacquire += ls[i].nacquire;
+    ls[j].ncontend += ls[i].ncontend;
+    ls[j].spin += ls[i].spin;
+    ls[j].hold += ls[i].hold;
+    if(ls[i].maxhold > ls[j].maxhold)
+      ls[j].maxhold = ls[i].maxhold;
+  }
+
+  // Sort by spin time.
+  for(i = 1; i < m; i++)
+    for(j = i; j > 0 && ls[j].spin > ls[j-1].spin; j--){
+      t = ls[j];
+      ls[j] = ls[j-1];
+      ls[j-1] = t;
+    }
+
+  printf(1, "name\t\tacquires\tcontended\tspin Kc\thold Kc\tmax hold c\n");
+  for(i = 0; i < m; i++){
+    printf(1, "%s\t", ls[i].name);
+    if(strlen(ls[i].name) < 8)
+      printf(1, "\t");
+    printf(1, "%d\t\t%d\t\t%d\t%d\t%d\n", ls[i].nacquire, ls[i].ncontend,
+           ls[i].spin, ls[i].hold, ls[i].maxhold);
+  }
+  exit();
+}
@@ -0,0 +1,12 @@
+// Spin lock statistics returned by the lockstat() system call.
+
+#define NLOCKSTAT 1024  // most locks one call returns
+
+struct lockstat {
+  char name[16];
+  uint nacquire;   // times acquired
+  uint ncontend;   // times acquire() had to wait
+  uint spin;       // cycles spent waiting, in units of 1024
+  uint hold;       // cycles held, in units of 1024
+  uint maxhold;    // longest hold, in cycles
+};
@@ -5,6 +5,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "logstat.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
@@ -17,138 +18,266 @@
 // A system call should call begin_op()/end_op() to mark
 // its start and end. Usually begin_op() just increments
 // the count of in-progress FS system calls and returns.
-// But if it thinks the log is close to running out, it
+// But if it thinks the transaction is close to full, it
 // sleeps until the last outstanding end_op() commits.
 //
-// The log is a physical re-do log containing disk blocks.
+// Each begin_op() reserves MAXOPBLOCKS of log space. Large
+// writes call begin_opn() instead, which reserves as much of
+// the free log space as they can use, so that one big write()
+// commits in as few transactions as the log size allows.
+//
+// The log is a physical re-do log containing disk blocks. It is
+// a ring that holds several committed transactions, and installing
+// them at their home locations (a checkpoint) is lazy: it happens
+// only when the ring, or the cache space for pinned blocks, has no
+// room left for another transaction. Until then committed blocks
+// stay pinned in the buffer cache, and a block that many
+// transactions rewrite is installed once.
+//
+// commit() copies the transaction to a staging area and lets new
+// FS system calls start while it writes that copy to the ring, so
+// begin_op() only waits for the copy, not for the disk.
+//
 // The on-disk log format:
-//   header block, containing block #s for block A, B, C, ...
-//   block A
-//   block B
-//   block C
-//   ...
-// Log appends are synchronous.
-
-// Contents of the header block, used for both the on-disk header block
-// and to keep track in memory of logged block# before commit.
+//   header block, containing the ring offset and sequence number
+//     of the oldest transaction that is not installed yet
+//   ring of transactions, each of them:
+//     descriptor block, containing block #s for block A, B, C, ...
+//     block A
+//     block B
+//     block C
+//     ...
+// Log appends are synchronous. A transaction commits when its
+// descriptor, which is written after its blocks, reaches the disk.
+// Recovery replays descriptors from the header's offset on for as
+// long as their sequence numbers follow each other.
+
+#define LOGMAGIC 0x10c5eade
+
+// Contents of the header block.
 struct logheader {
+  uint magic;
+  uint seq;   // sequence number of the transaction at tail
+  uint tail;  // ring offset of the oldest uninstalled transaction
+};
+
+#define LOGDESCMAX ((BSIZE - 4*sizeof(uint)) / sizeof(int))
+
+// Contents of a descriptor block.
+struct logdesc {
+  uint magic;
+  uint seq;
+  uint sum;   // checksum of seq, n and block[]
+  int n;
+  int block[LOGDESCMAX];
+};
+
+// Block #s logged by the open transaction.
+struct logtrans {
   int n;
-  int block[LOGSIZE];
+  int block[LOGTXSIZE];
 };
 
 struct log {
   struct spinlock lock;
   int start;
-  int size;
+  int size;        // blocks in the ring, after the header block
+  int cap;         // max data blocks in one transaction
   int outstanding; // how many FS sys calls are executing.
+  int reserved;    // log blocks reserved by outstanding sys calls
   int committing;  // in commit(), please wait.
+  int flushing;    // commit() is writing the staged copy to the ring
   int dev;
-  struct logheader lh;
+  int head;        // ring offset of the next descriptor
+  int used;        // ring blocks holding uninstalled transactions
+  uint seq;        // sequence number of the next transaction
+  int nckpt;       // # of committed blocks not installed yet
+  int ckpt[NCKPT]; // their block #s
+  uint ncommit;    // transactions committed since boot
+  uint nlogged;    // data blocks written through the log since boot
+  uint ncheckpoint; // checkpoints since boot
+  struct logtrans lh;
 };
 struct log log;
 
-static void recover_from_log(void);
+// Staged copy of the transaction being written to the ring.
+// Only the commit() that set log.flushing, or that holds
+// log.committing, touches it.
+static struct logdesc stagedesc;
+static uchar stage[LOGTXSIZE][BSIZE];
+
+static void recover_from_log(uint);
 static void commit();
 
 void
 initlog(int dev)
 {
-  if (sizeof(struct logheader) >= BSIZE)
-    panic("initlog: too big logheader");
+  if (sizeof(struct logdesc) > BSIZE)
+    panic("initlog: too big logdesc");
+  if (LOGTXSIZE > LOGDESCMAX)
+    panic("initlog: LOGTXSIZE");
 
   struct superblock sb;
   initlock(&log.lock, "log");
   readsb(dev, &sb);
   log.start = sb.logstart;
-  log.size = sb.nlog;
+  log.size = sb.nlog - 1;
+  log.cap = log.size - 1;
+  if (log.cap > LOGTXSIZE)
+    log.cap = LOGTXSIZE;
+  if (log.cap < MAXOPBLOCKS)
+    panic("initlog: log too small");
   log.dev = dev;
-  recover_from_log();
+  recover_from_log(sb.size);
 }
 
-// Copy committed blocks from log to their home location
-static void
-install_trans(void)
+// Disk block # of ring offset off.
+static int
+ringblock(int off)
 {
-  int tail;
+  return log.start + 1 + off % log.size;
+}
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    brelse(lbuf);
-    brelse(dbuf);
-  }
+static uint
+descsum(struct logdesc *d)
+{
+  uint sum;
+  int i;
+
+  sum = d->seq * 31 + d->n;
+  for (i = 0; i < d->n; i++)
+    sum = sum * 31 + d->block[i];
+  return sum;
 }
 
-// Read the log header from disk into the in-memory log header
-static void
-read_head(void)
+// Is d the descriptor of committed transaction seq?
+static int
+validdesc(struct logdesc *d, uint seq, uint fssize)
 {
-  struct buf *buf = bread(log.dev, log.start);
-  struct logheader *lh = (struct logheader *) (buf->data);
   int i;
-  log.lh.n = lh->n;
-  for (i = 0; i < log.lh.n; i++) {
-    log.lh.block[i] = lh->block[i];
-  }
-  brelse(buf);
+
+  if (d->magic != LOGMAGIC || d->seq != seq)
+    return 0;
+  if (d->n < 1 || d->n + 1 > log.size || d->n > LOGDESCMAX)
+    return 0;
+  if (d->sum != descsum(d))
+    return 0;
+  for (i = 0; i < d->n; i++)
+    if (d->block[i] <= log.start + log.size || d->block[i] >= fssize)
+      return 0;
+  return 1;
 }
 
-// Write in-memory log header to disk.
-// This is the true point at which the
-// current transaction commits.
+// Write the header block, so that recovery starts at log.head.
+// Everything before log.head must be installed.
 static void
 write_head(void)
 {
   struct buf *buf = bread(log.dev, log.start);
   struct logheader *hb = (struct logheader *) (buf->data);
-  int i;
-  hb->n = log.lh.n;
-  for (i = 0; i < log.lh.n; i++) {
-    hb->block[i] = log.lh.block[i];
-  }
+  hb->magic = LOGMAGIC;
+  hb->seq = log.seq;
+  hb->tail = log.head;
   bwrite(buf);
   brelse(buf);
 }
 
+// Copy committed blocks from the ring to their home locations.
 static void
-recover_from_log(void)
+recover_from_log(uint fssize)
 {
-  read_head();
-  install_trans(); // if committed, copy from log to disk
-  log.lh.n = 0;
+  struct buf *buf, *lbuf, *dbuf;
+  struct logheader *lh;
+  struct logdesc *d;
+  int i, off;
+  uint seq;
+
+  buf = bread(log.dev, log.start);
+  lh = (struct logheader *) (buf->data);
+  if (lh->magic == LOGMAGIC && lh->tail < log.size) {
+    off = lh->tail;
+    seq = lh->seq;
+  } else {
+    off = 0;  // new file system
+    seq = 1;
+  }
+  brelse(buf);
+
+  for (;;) {
+    buf = bread(log.dev, ringblock(off));
+    d = (struct logdesc *) (buf->data);
+    if (!validdesc(d, seq, fssize)) {
+      brelse(buf);
+      break;
+    }
+    for (i = 0; i < d->n; i++) {
+      lbuf = bread(log.dev, ringblock(off + 1 + i)); // read log block
+      dbuf = bread(log.dev, d->block[i]); // read dst
+      memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
+      bwrite(dbuf);  // write dst to disk
+      brelse(lbuf);
+      brelse(dbuf);
+    }
+    off = (off + 1 + d->n) % log.size;
+    seq++;
+    brelse(buf);
+  }
+
+  log.head = off;
+  log.seq = seq;
+  log.used = 0;
   write_head(); // clear the log
 }
 
-// called at the start of each FS system call.
-void
-begin_op(void)
+// called at the start of a FS system call that may write
+// up to want blocks. Waits until at least MAXOPBLOCKS are free,
+// then reserves as many of the wanted blocks as the log can
+// hold right now. Returns the number reserved, which the
+// caller must pass to end_opn().
+int
+begin_opn(int want)
 {
+  int n;
+
+  if(want < MAXOPBLOCKS)
+    want = MAXOPBLOCKS;
   acquire(&log.lock);
   while(1){
+    n = log.cap - log.lh.n - log.reserved;
     if(log.committing){
       sleep(&log, &log.lock);
-    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGSIZE){
+    } else if(n < MAXOPBLOCKS){
       // this op might exhaust log space; wait for commit.
       sleep(&log, &log.lock);
     } else {
+      if(n > want)
+        n = want;
       log.outstanding += 1;
+      log.reserved += n;
       release(&log.lock);
-      break;
+      return n;
     }
   }
 }
 
-// called at the end of each FS system call.
+// called at the start of each FS system call.
+void
+begin_op(void)
+{
+  begin_opn(MAXOPBLOCKS);
+}
+
+// called at the end of a FS system call that reserved
+// n log blocks with begin_opn().
 // commits if this was the last outstanding operation.
 void
-end_op(void)
+end_opn(int n)
 {
   int do_commit = 0;
 
   acquire(&log.lock);
   log.outstanding -= 1;
+  log.reserved -= n;
   if(log.committing)
     panic("log.committing");
   if(log.outstanding == 0){
@@ -164,46 +293,134 @@ end_op(void)
 
   if(do_commit){
     // call commit w/o holding locks, since not allowed
-    // to sleep with locks.
+    // to sleep with locks. commit() clears log.committing.
     commit();
-    acquire(&log.lock);
-    log.committing = 0;
-    wakeup(&log);
-    release(&log.lock);
   }
 }
 
-// Copy modified blocks from cache to log.
+// called at the end of each FS system call.
+void
+end_op(void)
+{
+  end_opn(MAXOPBLOCKS);
+}
+
+// Copy modified blocks from cache to the staging area.
 static void
-write_log(void)
+stage_trans(void)
 {
-  int tail;
+  int i;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
-    struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
+  for (i = 0; i < log.lh.n; i++) {
+    struct buf *from = bread(log.dev, log.lh.block[i]); // cache block
+    memmove(stage[i], from->data, BSIZE);
     brelse(from);
-    brelse(to);
+    stagedesc.block[i] = log.lh.block[i];
+  }
+  stagedesc.n = log.lh.n;
+  stagedesc.magic = LOGMAGIC;
+  stagedesc.seq = log.seq;
+  stagedesc.sum = descsum(&stagedesc);
+}
+
+// Write the staged transaction to the ring at offset off.
+static void
+write_log(int off)
+{
+  struct buf *buf;
+  int i;
+
+  for (i = 0; i < stagedesc.n; i++) {
+    buf = bread(log.dev, ringblock(off + 1 + i)); // log block
+    memmove(buf->data, stage[i], BSIZE);
+    bwrite(buf);  // write the log
+    brelse(buf);
+  }
+  buf = bread(log.dev, ringblock(off));
+  memmove(buf->data, &stagedesc, BSIZE);
+  bwrite(buf);  // Write descriptor to disk -- the real commit
+  brelse(buf);
+}
+
+// Install all committed blocks from the cache to their home
+// locations and empty the ring. Only called while no FS system
+// calls are active, so the cache holds committed data only.
+static void
+checkpoint(void)
+{
+  int i;
+
+  for (i = 0; i < log.nckpt; i++) {
+    struct buf *buf = bread(log.dev, log.ckpt[i]);
+    bwrite(buf);  // write dst to disk, unpins it
+    brelse(buf);
   }
+  log.nckpt = 0;
+  log.used = 0;
+  log.ncheckpoint++;
+  write_head();
 }
 
 static void
 commit()
 {
-  if (log.lh.n > 0) {
-    write_log();     // Write modified blocks from cache to log
-    write_head();    // Write header to disk -- the real commit
-    install_trans(); // Now install writes to home locations
+  int i, j, n, off, full;
+
+  acquire(&log.lock);
+  while (log.flushing)  // previous transaction still going to the ring
+    sleep(&log, &log.lock);
+  release(&log.lock);
+
+  n = log.lh.n;
+  if (n > 0) {
+    // Checkpoint now, while no FS sys calls can run, unless the
+    // ring and the cache have room for a full transaction after
+    // this one.
+    full = log.size - log.used - (n + 1) < log.cap + 1 ||
+           log.nckpt + n > NCKPT - log.cap;
+    stage_trans();
+    for (i = 0; i < n; i++) {
+      for (j = 0; j < log.nckpt; j++)
+        if (log.ckpt[j] == log.lh.block[i])
+          break;
+      if (j == log.nckpt)
+        log.ckpt[log.nckpt++] = log.lh.block[i];
+    }
+    off = log.head;
+    log.head = (log.head + n + 1) % log.size;
+    log.used += n + 1;
+    log.seq++;
+
+    acquire(&log.lock);
+    log.ncommit++;
+    log.nlogged += n;
     log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
+    if (!full) {
+      // New FS sys calls only modify the cache, not the staged
+      // copy, so they can run while it is written.
+      log.flushing = 1;
+      log.committing = 0;
+      wakeup(&log);
+    }
+    release(&log.lock);
+
+    write_log(off);
+    if (full)
+      checkpoint();
   }
+
+  acquire(&log.lock);
+  if (log.flushing)
+    log.flushing = 0;
+  else
+    log.committing = 0;
+  wakeup(&log);
+  release(&log.lock);
 }
 
 // Caller has modified b->data and is done with the buffer.
 // Record the block number and pin in the cache with B_DIRTY.
-// commit()/write_log() will do the disk write.
+// commit() logs the block and a later checkpoint() unpins it.
 //
 // log_write() replaces bwrite(); a typical use is:
 //   bp = bread(...)
@@ -215,7 +432,7 @@ log_write(struct buf *b)
 {
   int i;
 
-  if (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1)
+  if (log.lh.n >= log.cap)
     panic("too big a transaction");
   if (log.outstanding < 1)
     panic("log_write outside of trans");
@@ -232,3 +449,15 @@ log_write(struct buf *b)
   release(&log.lock);
 }
 
+// Copy log statistics for the logstat() system call.
+void
+logstat(struct logstat *st)
+{
+  acquire(&log.lock);
+  st->commits = log.ncommit;
+  st->blocks = log.nlogged;
+  st->size = log.cap;
+  st->checkpoints = log.ncheckpoint;
+  st->ring = log.size;
+  release(&log.lock);
+}
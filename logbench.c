@@ -0,0 +1,57 @@
+// Measure how many log transactions it takes to write a megabyte
+// of file data with write() calls of various sizes.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fs.h"
+#include "fcntl.h"
+#include "logstat.h"
+
+#define FILESZ (64*1024)  // fits in MAXFILE blocks
+#define TOTAL (1024*1024)
+
+char data[FILESZ];
+int sizes[] = { 512, 1536, 4096, 16384, FILESZ };
+
+int
+main(int argc, char *argv[])
+{
+  struct logstat st0, st1;
+  int i, fd, n, off, t0;
+
+  if(logstat(&st0) < 0){
+    printf(2, "logbench: logstat failed\n");
+    exit();
+  }
+  printf(1, "logbench: %d log blocks per transaction, %d in the ring\n",
+         st0.size, st0.ring);
+  printf(1, "write size\tcommits/MB\tlog blocks/MB\tcheckpoints/MB\tms/MB\n");
+  memset(data, 'a', sizeof(data));
+
+  for(i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++){
+    unlink("logbench.tmp");
+    logstat(&st0);
+    t0 = uptime();
+    for(n = 0; n < TOTAL; n += FILESZ){
+      fd = open("logbench.tmp", O_CREATE | O_RDWR);
+      if(fd < 0){
+        printf(2, "logbench: cannot create logbench.tmp\n");
+        exit();
+      }
+      for(off = 0; off < FILESZ; off += sizes[i]){
+        if(write(fd, data, sizes[i]) != sizes[i]){
+          printf(2, "logbench: write failed\n");
+          exit();
+        }
+      }
+      close(fd);
+    }
+    logstat(&st1);
+    printf(1, "%d\t\t%d\t\t%d\t\t%d\t\t%d\n", sizes[i],
+           st1.commits - st0.commits, st1.blocks - st0.blocks,
+           st1.checkpoints - st0.checkpoints, uptime() - t0);
+  }
+  unlink("logbench.tmp");
+  exit();
+}
@@ -0,0 +1,9 @@
+// Log statistics returned by the logstat() system call.
+
+struct logstat {
+  uint commits;  // transactions committed since boot
+  uint blocks;   // data blocks written through the log since boot
+  uint size;     // max data blocks in one transaction
+  uint checkpoints; // times the log was installed since boot
+  uint ring;     // on-disk log blocks, excluding the header
+};
@@ -18,9 +18,12 @@ int
 main(void)
 {
   kinit1(end, P2V(4*1024*1024)); // phys page allocator
+  kmallocinit();   // kernel object allocator
+  vdsoinit();      // page shared with user code
   kvmalloc();      // kernel page table
   mpinit();        // detect other processors
   lapicinit();     // interrupt controller
+  stringinit();    // fast memmove
   seginit();       // segment descriptors
   picinit();       // disable pic
   ioapicinit();    // another interrupt controller
@@ -30,6 +33,8 @@ main(void)
   tvinit();        // trap vectors
   binit();         // buffer cache
   fileinit();      // file table
+  futexinit();     // futex wait queues
+  schedtraceinit(); // scheduler event rings
   ideinit();       // disk 
   startothers();   // start other processors
   kinit2(P2V(4*1024*1024), P2V(PHYSTOP)); // must come after startothers()
@@ -41,6 +46,7 @@ main(void)
 static void
 mpenter(void)
 {
+  stringinit();
   switchkvm();
   seginit();
   lapicinit();
@@ -53,6 +59,7 @@ mpmain(void)
 {
   cprintf("cpu%d: starting %d\n", cpuid(), cpuid());
   idtinit();       // load idt register
+  sysenterinit();  // sysenter system call entry
   xchg(&(mycpu()->started), 1); // tell startothers() we're up
   scheduler();     // start running processes
 }
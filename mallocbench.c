@@ -0,0 +1,152 @@
+// Compare the K&R first-fit allocator that umalloc.c used to be
+// with the current one on a mix of small and large requests.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+
+#define NSLOT 512
+#define NOPS 200000
+
+// The original umalloc.c, renamed.
+
+typedef long Align;
+
+union header {
+  struct {
+    union header *ptr;
+    uint size;
+  } s;
+  Align x;
+};
+
+typedef union header Header;
+
+static Header base;
+static Header *freep;
+
+static void
+krfree(void *ap)
+{
+  Header *bp, *p;
+
+  bp = (Header*)ap - 1;
+  for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
+    if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
+      break;
+  if(bp + bp->s.size == p->s.ptr){
+    bp->s.size += p->s.ptr->s.size;
+    bp->s.ptr = p->s.ptr->s.ptr;
+  } else
+    bp->s.ptr = p->s.ptr;
+  if(p + p->s.size == bp){
+    p->s.size += bp->s.size;
+    p->s.ptr = bp->s.ptr;
+  } else
+    p->s.ptr = bp;
+  freep = p;
+}
+
+static Header*
+krmorecore(uint nu)
+{
+  char *p;
+  Header *hp;
+
+  if(nu < 4096)
+    nu = 4096;
+  p = sbrk(nu * sizeof(Header));
+  if(p == (char*)-1)
+    return 0;
+  hp = (Header*)p;
+  hp->s.size = nu;
+  krfree((void*)(hp + 1));
+  return freep;
+}
+
+static void*
+krmalloc(uint nbytes)
+{
+  Header *p, *prevp;
+  uint nunits;
+
+  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
+  if((prevp = freep) == 0){
+    base.s.ptr = freep = prevp = &base;
+    base.s.size = 0;
+  }
+  for(p = prevp->s.ptr; ; prevp = p, p = p->s.ptr){
+    if(p->s.size >= nunits){
+      if(p->s.size == nunits)
+        prevp->s.ptr = p->s.ptr;
+      else {
+        p->s.size -= nunits;
+        p += p->s.size;
+        p->s.size = nunits;
+      }
+      freep = prevp;
+      return (void*)(p + 1);
+    }
+    if(p == freep)
+      if((p = krmorecore(nunits)) == 0)
+        return 0;
+  }
+}
+
+void *slot[NSLOT];
+uint seed;
+
+static uint
+rand(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return seed >> 8;
+}
+
+// Mostly small blocks, with one in sixteen between 1 and 8 KB.
+static uint
+randsize(void)
+{
+  uint r = rand();
+
+  if(r % 16 == 0)
+    return 1024 + r % (7*1024);
+  return 8 + r % 248;
+}
+
+static void
+run(char *name, void *(*alloc)(uint), void (*release)(void*))
+{
+  int i, j, t0, t1;
+  char *brk0;
+
+  seed = 1;
+  brk0 = sbrk(0);
+  t0 = uptime();
+  for(i = 0; i < NOPS; i++){
+    j = rand() % NSLOT;
+    if(slot[j]){
+      release(slot[j]);
+      slot[j] = 0;
+    } else if((slot[j] = alloc(randsize())) == 0){
+      printf(2, "mallocbench: %s: out of memory\n", name);
+      exit();
+    }
+  }
+  for(j = 0; j < NSLOT; j++){
+    if(slot[j])
+      release(slot[j]);
+    slot[j] = 0;
+  }
+  t1 = uptime();
+  printf(1, "%s\t%d ops\t%d ticks\theap +%d KB\n",
+         name, NOPS, t1 - t0, (sbrk(0) - brk0) / 1024);
+}
+
+int
+main(int argc, char *argv[])
+{
+  run("first-fit", krmalloc, krfree);
+  run("malloc", malloc, free);
+  exit();
+}
@@ -0,0 +1,44 @@
+// Report bytes per cycle for the kernel's memmove() and
+// memcmp() implementations.
+
+#include "types.h"
+#include "user.h"
+#include "membench.h"
+
+// Print n/cycles with two decimals.
+static void
+rate(uint n, uint cycles)
+{
+  uint r;
+
+  if(cycles == 0){
+    printf(1, "\t-");
+    return;
+  }
+  r = n * 100 / cycles;
+  printf(1, "\t%d.%d%d", r / 100, r / 10 % 10, r % 10);
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct membench mb;
+  int i;
+
+  if(membench(&mb) < 0){
+    printf(2, "membench: membench failed\n");
+    exit();
+  }
+  printf(1, "bytes/cycle\tbytemove\tmovsl\tsse2\tbytecmp\twordcmp\n");
+  for(i = 0; i < NMEMBENCH; i++){
+    printf(1, "%d\t", mb.size[i]);
+    rate(mb.size[i], mb.bytemove[i]);
+    printf(1, "\t");
+    rate(mb.size[i], mb.wordmove[i]);
+    rate(mb.size[i], mb.ssemove[i]);
+    rate(mb.size[i], mb.bytecmp[i]);
+    rate(mb.size[i], mb.wordcmp[i]);
+    printf(1, "\n");
+  }
+  exit();
+}
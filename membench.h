@@ -0,0 +1,14 @@
+// Results of the membench() system call: average cycles taken
+// by each memmove() and memcmp() implementation in string.c
+// for a buffer of each size.
+
+#define NMEMBENCH 4
+
+struct membench {
+  uint size[NMEMBENCH];      // bytes
+  uint bytemove[NMEMBENCH];  // byte loop
+  uint wordmove[NMEMBENCH];  // rep movsl
+  uint ssemove[NMEMBENCH];   // SSE2, or 0 if the CPU has none
+  uint bytecmp[NMEMBENCH];   // byte loop
+  uint wordcmp[NMEMBENCH];   // word loop
+};
@@ -7,6 +7,9 @@
 // Key addresses for address space layout (see kmap in vm.c for layout)
 #define KERNBASE 0x80000000         // First kernel virtual address
 #define KERNLINK (KERNBASE+EXTMEM)  // Address where kernel is linked
+#define VDSOTIME (KERNBASE-0x2000)  // User-readable page with the time
+#define VDSOPROC (KERNBASE-0x1000)  // User-readable page with the pid
+#define USERTOP  VDSOTIME           // End of user memory
 
 #define V2P(a) (((uint) (a)) - KERNBASE)
 #define P2V(a) (((void *) (a)) + KERNBASE)
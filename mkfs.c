@@ -76,8 +76,18 @@ main(int argc, char *argv[])
 
   static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
 
+  if(argc > 2 && strcmp(argv[1], "-l") == 0){
+    nlog = atoi(argv[2]);
+    argc -= 2;
+    argv += 2;
+  }
   if(argc < 2){
-    fprintf(stderr, "Usage: mkfs fs.img files...\n");
+    fprintf(stderr, "Usage: mkfs [-l nlog] fs.img files...\n");
+    exit(1);
+  }
+  // header block, one descriptor and at least MAXOPBLOCKS data blocks
+  if(nlog < MAXOPBLOCKS + 2){
+    fprintf(stderr, "mkfs: log must have at least %d blocks\n", MAXOPBLOCKS + 2);
     exit(1);
   }
 
@@ -92,6 +102,7 @@ main(int argc, char *argv[])
 
   // 1 fs block = 1 disk sector
   nmeta = 2 + nlog + ninodeblocks + nbitmap;
+  assert(nmeta < FSSIZE);
   nblocks = FSSIZE - nmeta;
 
   sb.size = xint(FSSIZE);
@@ -24,6 +24,15 @@
 #define FL_VIP          0x00100000      // Virtual Interrupt Pending
 #define FL_ID           0x00200000      // ID flag
 
+// Model specific registers
+#define MSR_SYSENTER_CS  0x174   // kernel %cs for sysenter
+#define MSR_SYSENTER_ESP 0x175   // kernel %esp for sysenter
+#define MSR_SYSENTER_EIP 0x176   // kernel entry point for sysenter
+
+// CPUID function 1 feature flags in %edx
+#define CPUID_SEP       0x00000800      // sysenter/sysexit
+#define CPUID_SSE2      0x04000000      // SSE2 instructions
+
 // Control Register flags
 #define CR0_PE          0x00000001      // Protection Enable
 #define CR0_MP          0x00000002      // Monitor coProcessor
@@ -38,6 +47,7 @@
 #define CR0_PG          0x80000000      // Paging
 
 #define CR4_PSE         0x00000010      // Page size extension
+#define CR4_OSFXSR      0x00000200      // OS supports SSE
 
 // various segment selectors.
 #define SEG_KCODE 1  // kernel code
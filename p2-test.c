@@ -14,6 +14,7 @@
 #define TIME_TEST
 
 #ifdef GETPROCS_TEST
+#include "param.h"
 #include "uproc.h"
 #endif
 
@@ -252,25 +253,54 @@ testcputime(char *name)
   if (success == 0)
     printf(1, "** All Tests Passed! **\n");
 }
+
+// A child that spins for 200 ms should show up in cputime()
+// once waited for, to within the microseconds reported.
+static void
+testcputimechildren(void)
+{
+  struct cputime before, after;
+  int t0, ms;
+
+  printf(1, "\n----------\nRunning cputime() Test\n----------\n");
+  cputime(&before);
+  if (fork() == 0)
+  {
+    t0 = uptime();
+    while (uptime() - t0 < 200)
+      ;
+    exit();
+  }
+  wait();
+  cputime(&after);
+  ms = after.children_ms - before.children_ms;
+  printf(1, "Child CPU time: %d ms, %d us\n", ms, after.children_us);
+  if (after.us >= 1000 || after.children_us >= 1000)
+    printf(2, "FAILED: microseconds out of range\n");
+  else if (ms < 150 || ms > 250)
+    printf(2, "FAILED: child ran for 200 ms of CPU time\n");
+  else
+    printf(1, "** All Tests Passed! **\n");
+}
 #endif
 #endif
 
 #ifdef GETPROCS_TEST
-// Fork to 64 process and then make sure we get all when passing table array
-// of sizes 1, 16, 64, 72. NOTE: caller does all forks.
+// The process table fills up, or memory runs out, before the fork loop
+// in testgetprocs() stops, so the tester allocates these beforehand.
+#define MAXTABLE (NPROC + 8)
+static struct uproc *bigtable;   // MAXTABLE entries
+static struct uproc *smalltable; // one entry, at the top of the heap
+
+// Fork until the process table is full and then make sure we get all when
+// passing table arrays of sizes 1, 16, the number of processes, and more.
+// NOTE: caller does all forks.
 static int
 testprocarray(int max, int expected_ret)
 {
-  struct uproc *table;
   int ret, success = 0;
 
-  table = malloc(sizeof(struct uproc) * max); // bad code, assumes success
-  if (!table)
-  {
-    printf(2, "Error: malloc() call failed. %s at line %d\n", __FUNCTION__, __LINE__);
-    exit();
-  }
-  ret = getprocs(max, table);
+  ret = getprocs(max, bigtable);
   if (ret != expected_ret)
   {
     printf(2, "FAILED: getprocs(%d) returned %d, expected %d\n", max, ret, expected_ret);
@@ -281,24 +311,15 @@ testprocarray(int max, int expected_ret)
     printf(2, "getprocs() was asked for %d processes and returned %d. SUCCESS\n", max, expected_ret);
   }
   sleep(5000);
-  free(table);
   return success;
 }
 
 static int
 testinvalidarray(void)
 {
-  struct uproc *table;
   int ret;
 
-  table = malloc(sizeof(struct uproc));
-  if (!table)
-  {
-    printf(2, "Error: malloc() call failed. %s at line %d\n", __FUNCTION__, __LINE__);
-    exit();
-  }
-  ret = getprocs(1024, table);
-  free(table);
+  ret = getprocs(1024, smalltable);
   if (ret >= 0)
   {
     printf(2, "FAILED: called getprocs with max way larger than table and returned %d, not error\n", ret);
@@ -310,9 +331,49 @@ testinvalidarray(void)
 static void
 testgetprocs()
 {
-  int ret, success;
+  int ret, success, nprocs, go[2], done[2];
+  char c;
 
   printf(1, "\n----------\nRunning GetProcs Test\n----------\n");
+  if (pipe(go) < 0 || pipe(done) < 0)
+  {
+    printf(2, "Error: pipe() call failed. %s at line %d\n", __FUNCTION__, __LINE__);
+    exit();
+  }
+  // A tester allocates the tables, so that the forks below do not copy
+  // them, and waits for the table to fill.
+  ret = fork();
+  if (ret == 0)
+  {
+    close(go[1]);
+    bigtable = malloc(sizeof(struct uproc) * MAXTABLE);
+    smalltable = malloc(sizeof(struct uproc));
+    if (!bigtable || !smalltable)
+    {
+      printf(2, "Error: malloc() call failed. %s at line %d\n", __FUNCTION__, __LINE__);
+      exit();
+    }
+    write(done[1], "x", 1);
+    read(go[0], &c, 1);
+    nprocs = getprocs(MAXTABLE, bigtable);
+    printf(1, "%d processes\n", nprocs);
+    success = testinvalidarray();
+    success |= testprocarray(1, 1);
+    success |= testprocarray(16, 16);
+    success |= testprocarray(nprocs, nprocs);
+    success |= testprocarray(nprocs + 8, nprocs);
+
+    if (success == 0)
+      printf(1, "** All Tests Passed **\n");
+    write(done[1], "x", 1);
+    exit();
+  }
+  close(done[1]);
+  if (read(done[0], &c, 1) != 1)
+  {
+    wait();
+    return;
+  }
   printf(1, "Filling the proc[] array with dummy processes\n");
   // Fork until no space left in ptable
   ret = fork();
@@ -326,17 +387,16 @@ testgetprocs()
       exit();
     }
     // Only return left is -1, which is no space left in ptable
-    success = testinvalidarray();
-    success |= testprocarray(1, 1);
-    success |= testprocarray(16, 16);
-    success |= testprocarray(64, 64);
-    success |= testprocarray(72, 64);
-
-    if (success == 0)
-      printf(1, "** All Tests Passed **\n");
+    // (or no memory for another process, before NPROC of them).
+    write(go[1], "x", 1);
+    read(done[0], &c, 1);
     exit();
   }
   wait();
+  wait();
+  close(go[0]);
+  close(go[1]);
+  close(done[0]);
 }
 #endif
 
@@ -425,6 +485,7 @@ int main(int argc, char *argv[])
 {
 #ifdef CPUTIME_TEST
   testcputime(argv[0]);
+  testcputimechildren();
 #endif
 #ifdef UIDGIDPPID_TEST
   testuidgid();
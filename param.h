@@ -1,17 +1,21 @@
-#define NPROC 64                  // maximum number of processes
+#ifndef NPROC
+#define NPROC 4096                // maximum number of processes
+#endif
 #define KSTACKSIZE 4096           // size of per-process kernel stack
 #define NCPU 8                    // maximum number of CPUs
 #define NOFILE 16                 // open files per process
-#define NFILE 100                 // open files per system
-#define NINODE 50                 // maximum number of active i-nodes
+#define NFILE 1000                // open files per system
+#define NINODE 500                // maximum number of active i-nodes
 #define NDEV 10                   // maximum major device number
 #define ROOTDEV 1                 // device number of file system root disk
 #define MAXARG 32                 // max exec arguments
 #define MAXOPBLOCKS 10            // max # of blocks any FS op writes
-#define LOGSIZE (MAXOPBLOCKS * 3) // max data blocks in on-disk log
-#define NBUF (MAXOPBLOCKS * 3)    // size of disk block cache
+#define LOGTXSIZE (MAXOPBLOCKS * 8) // max data blocks in one log transaction
+#define LOGSIZE (LOGTXSIZE * 3)   // default # of on-disk log blocks (mkfs -l)
+#define NCKPT (LOGTXSIZE * 2)     // max committed blocks awaiting checkpoint
+#define NBUF (NCKPT + LOGTXSIZE + 2*MAXOPBLOCKS) // size of disk block cache
 #ifdef PDX_XV6
-#define FSSIZE 2000 // size of file system in blocks
+#define FSSIZE 4000 // size of file system in blocks
 #else
 #define FSSIZE 1000 // size of file system in blocks
 #endif              // PDX_XV6
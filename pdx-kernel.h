@@ -15,6 +15,14 @@ hlt()
   asm volatile("hlt");
 }
 
+// Enable interrupts and halt, with no window between them for
+// an interrupt to be taken before the hlt.
+static inline void
+stihlt()
+{
+  asm volatile("sti; hlt");
+}
+
 // atom_inc() necessary for removal of tickslock
 // other atomic ops added for completeness
 static inline void
@@ -19,7 +19,9 @@
 #define TPS 1000                   // ticks-per-second
 #define SCHED_INTERVAL (TPS / 100) // see trap.c
 
-#define NPROC 64 // maximum number of processes -- normally in param.h
+#ifndef NPROC
+#define NPROC 4096 // maximum number of processes -- normally in param.h
+#endif
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 #define max(a, b) ((a) > (b) ? (a) : (b))
@@ -37,6 +39,15 @@
 #define MAXPRIO 6
 #define DEFAULT_BUDGET 100
 #define TICKS_TO_PROMOTE 30000
+
+// scheduling policies for setscheduler()
+#define SCHED_MLFQ 0 // multi-level feedback queue on priority
+#define SCHED_CFS 1  // completely fair: least weighted CPU time runs next
+#ifndef SCHED_DEFAULT
+#define SCHED_DEFAULT SCHED_MLFQ
+#endif
+#define DEFAULT_SHARE 1024 // CFS weight of each uid until setshare()
+#define MAX_SHARE (DEFAULT_SHARE * 64)
 #endif
 
 #endif // PDX_INCLUDE
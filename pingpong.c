@@ -0,0 +1,73 @@
+// Time round trips of a byte over a pair of pipes between two
+// processes, first on different CPUs and then sharing one. Each
+// trip wakes a process up, so it also times how fast an idle
+// CPU notices new work.
+
+#include "types.h"
+#include "user.h"
+
+#define TRIPS 10000
+
+// Bounce a byte between a parent on CPU cpu0 and a child on
+// CPU cpu1. Returns the time in ticks.
+int
+bounce(int cpu0, int cpu1)
+{
+  int ping[2], pong[2], i, t0, t;
+  char c;
+
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    printf(2, "pingpong: pipe failed\n");
+    exit();
+  }
+  sched_setaffinity(getpid(), 1 << cpu0);
+  if(fork() == 0){
+    sched_setaffinity(getpid(), 1 << cpu1);
+    for(i = 0; i < TRIPS; i++){
+      if(read(ping[0], &c, 1) != 1)
+        break;
+      write(pong[1], &c, 1);
+    }
+    exit();
+  }
+  c = 'x';
+  t0 = uptime();
+  for(i = 0; i < TRIPS; i++){
+    write(ping[1], &c, 1);
+    if(read(pong[0], &c, 1) != 1){
+      printf(2, "pingpong: read failed\n");
+      break;
+    }
+  }
+  t = uptime() - t0;
+  wait();
+  close(ping[0]);
+  close(ping[1]);
+  close(pong[0]);
+  close(pong[1]);
+  return t;
+}
+
+void
+report(char *what, int t)
+{
+  int us = t * 1000 / TRIPS;
+
+  printf(1, "%s: %d round trips in %d ticks, %d.%d us each\n", what,
+         TRIPS, t, us, t * 10000 / TRIPS % 10);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int all;
+
+  all = sched_getaffinity(getpid());
+  if(all & 2)
+    report("cpu0 <-> cpu1", bounce(0, 1));
+  else
+    printf(1, "pingpong: only one CPU\n");
+  report("cpu0 <-> cpu0", bounce(0, 0));
+  sched_setaffinity(getpid(), all);
+  exit();
+}
@@ -4,8 +4,13 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "x86.h"
+#include "traps.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "slab.h"
+#include "rwlock.h"
+#include "sleeplock.h"
+#include "schedtrace.h"
 
 #ifdef CS333_P2
 #include "uproc.h"
@@ -30,30 +35,95 @@ struct ptrs
 };
 #endif
 
+#define NPIDHASH 1024 // pid hash chains, a power of 2
+#define AFFINITY_WAIT 2 // ticks a process waits for its last CPU; see runhere()
+#define USPERTICK (1000000 / TPS)
+
+#ifdef CS333_P4
+#define CFS_NICE0 1024    // CFS weight of a process at MAXPRIO
+#define CFS_NICESTEP 3    // nice levels per priority level
+#define CFS_SLACK ((uint64)SCHED_INTERVAL * USPERTICK << 10) // see readyAdd()
+#define BUDGET (DEFAULT_BUDGET * USPERTICK) // MLFQ budget in microseconds
+#define NSHARE 64         // uids with a CFS share of their own at once
+#define RT_UNIT 1024      // utilization of a reservation of a whole CPU
+#define PI_MAXDEPTH 8     // sleeplock holders to boost; see sleeplockwait()
+#define RT_MAXPERIOD 100000 // ticks; keeps runtime * RT_UNIT in an int
+
+// A uid's part of the CPU under CFS. Shares compete on vruntime
+// the way processes do, and then the winner's processes compete
+// among themselves.
+struct share
+{
+  uint uid;
+  int weight;          // see setshare()
+  int nready;          // RUNNABLE procs in ready
+  struct proc *ready;  // leftist heap on vruntime; see cfsmerge()
+  uint64 vruntime;     // weighted CPU time of all of uid's procs
+  uint64 minvruntime;  // vruntime of the last proc picked from ready
+};
+#endif
+
 static struct
 {
 #define statecount NELEM(states)
   struct spinlock lock;
-  struct proc proc[NPROC];
+  struct proc *all; // every proc allocated so far, linked by allnext
+  struct proc *alltail;
+  int nproc;        // length of all, at most NPROC
 #ifdef CS333_P3
   struct ptrs list[statecount];
+#else
+  struct proc *unused; // UNUSED procs, linked by next
 #endif
 #ifdef CS333_P4
   struct ptrs ready[MAXPRIO + 1];
   uint PromoteAtTime;
+  uint epoch; // promotions so far; see promote()
+  int policy; // SCHED_MLFQ or SCHED_CFS
+  struct share shares[NSHARE]; // under SCHED_CFS, RUNNABLE procs by uid
+  int nshare;
+  uint64 minvruntime;          // vruntime of the last share picked to run
+  struct ptrs rt;              // RUNNABLE real-time procs by deadline
 #endif
+  struct proc *pidhash[NPIDHASH]; // chains of procs by pid
+  struct rwlock pidlock;          // pidhash; see pidlookup()
 } ptable;
 
 // list management function prototypes
 #ifdef CS333_P3
 static void initProcessLists(void);
-static void initFreeList(void);
 static void stateListAdd(struct ptrs *, struct proc *);
 static int stateListRemove(struct ptrs *, struct proc *p);
 static void assertState(struct proc *, enum procstate, const char *, int);
 #endif
+#ifdef CS333_P4
+static void stateListAppend(struct ptrs *, struct ptrs *);
+static int curpriority(struct proc *);
+static void promote(struct proc *);
+static void readyAdd(struct proc *);
+static struct proc *readyPop(int);
+static void charge(struct proc *);
+static struct share *sharefor(uint);
+static void rtupdate(struct proc *);
+static void rtinsert(struct proc *);
+static void preempt(struct proc *);
+#endif
+
+static void pidhashinsert(struct proc *);
+static void pidhashremove(struct proc *);
+static struct proc *pidlookup(int);
+static void reparent(struct proc *);
+static void reap(struct proc *);
+#ifdef CS333_P2
+static void cyclestime(uint64, uint *, uint *);
+#endif
+static void killproc(struct proc *);
+static int runhere(struct proc *, int);
+static void runon(struct proc *, int);
+static int kickidle(struct proc *);
 
 static struct proc *initproc;
+static struct slabcache proccache; // struct procs come from here
 
 uint nextpid = 1;
 extern void forkret(void);
@@ -63,6 +133,28 @@ static void wakeup1(void *chan);
 void pinit(void)
 {
   initlock(&ptable.lock, "ptable");
+  initrwlock(&ptable.pidlock, "pidhash");
+  slabinit(&proccache, "proc", sizeof(struct proc));
+}
+
+// Allocate a new UNUSED proc and add it to ptable.all. procs are
+// never freed, so walking ptable.all without the lock is safe.
+// Caller holds ptable.lock.
+static struct proc *
+newproc(void)
+{
+  struct proc *p;
+
+  if (ptable.nproc >= NPROC || (p = slaballoc(&proccache)) == 0)
+    return 0;
+  p->state = UNUSED;
+  if (ptable.all == 0)
+    ptable.all = p;
+  else
+    ptable.alltail->allnext = p;
+  ptable.alltail = p;
+  ptable.nproc++;
+  return p;
 }
 
 // Must be called with interrupts disabled
@@ -108,8 +200,21 @@ myproc(void)
   return p;
 }
 
+// Whether a process has been woken up that should run in place
+// of the current one; see preempt().
+int needresched(void)
+{
+  int r;
+
+  pushcli();
+  r = mycpu()->needresched;
+  popcli();
+  return r;
+}
+
 //PAGEBREAK: 32
-// Look in the process table for an UNUSED proc.
+// Look in the process table for an UNUSED proc,
+// or allocate a new one if there is none.
 // If found, change state to EMBRYO and initialize
 // state required to run in the kernel.
 // Otherwise return 0.
@@ -119,36 +224,38 @@ allocproc(void)
   struct proc *p;
   char *sp;
   acquire(&ptable.lock);
-  int found = 0;
-  for (p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    if (p->state == UNUSED)
-    {
-      found = 1;
-      break;
-    }
-  if (!found)
+#ifdef CS333_P3
+  if ((p = ptable.list[UNUSED].head) != 0)
+  {
+    if (stateListRemove(&ptable.list[UNUSED], p) == -1)
+      panic("Error occur when remove p from the list UNUSED");
+    assertState(p, UNUSED, __FILE__, __LINE__);
+  }
+#else
+  if ((p = ptable.unused) != 0)
+    ptable.unused = p->next;
+#endif
+  if (p == 0 && (p = newproc()) == 0)
   {
     release(&ptable.lock);
     return 0;
   }
-#ifdef CS333_P3
-  if (stateListRemove(&ptable.list[UNUSED], p) == -1)
-    panic("Error occur when remove p from the list UNUSED");
-  assertState(p, UNUSED, __FILE__, __LINE__);
-#endif
   p->state = EMBRYO;
 #ifdef CS333_P3
   stateListAdd(&ptable.list[EMBRYO], p);
   assertState(p, EMBRYO, __FILE__, __LINE__);
 #endif
   p->pid = nextpid++;
+  p->children = 0;
+  pidhashinsert(p);
   release(&ptable.lock);
 
   // Allocate kernel stack.
   if ((p->kstack = kalloc()) == 0)
   {
-#ifdef CS333_P3
     acquire(&ptable.lock);
+    pidhashremove(p);
+#ifdef CS333_P3
     if (stateListRemove(&ptable.list[EMBRYO], p) == -1)
       panic("Error occur when remove p from the list EMBRYO");
     assertState(p, EMBRYO, __FILE__, __LINE__);
@@ -157,8 +264,11 @@ allocproc(void)
 #ifdef CS333_P3
     stateListAdd(&ptable.list[UNUSED], p);
     assertState(p, UNUSED, __FILE__, __LINE__);
-    release(&ptable.lock);
+#else
+    p->next = ptable.unused;
+    ptable.unused = p;
 #endif
+    release(&ptable.lock);
     return 0;
   }
   sp = p->kstack + KSTACKSIZE;
@@ -177,13 +287,26 @@ allocproc(void)
   memset(p->context, 0, sizeof *p->context);
   p->context->eip = (uint)forkret;
   p->start_ticks = ticks;
+  p->cpumask = ~0;
+  p->lastcpu = -1;
+  p->migrations = 0;
 #ifdef CS333_P2
   p->cpu_ticks_in = 0;
-  p->cpu_ticks_total = 0;
+  p->cpu_cycles_in = 0;
+  p->cpu_cycles_total = 0;
+  p->cpu_cycles_children = 0;
 #endif
 #ifdef CS333_P4
   p->priority = MAXPRIO;
-  p->budget = DEFAULT_BUDGET;
+  p->budget = BUDGET;
+  p->epoch = ptable.epoch;
+  p->vruntime = 0; // readyAdd() moves it up to its share's
+  p->share = 0;
+  p->rtperiod = 0;
+  p->rtmisses = 0;
+  p->boosted = 0;
+  p->held = 0;
+  p->blockedon = 0;
 #endif
   return p;
 }
@@ -195,7 +318,6 @@ void userinit(void)
 #ifdef CS333_P3
   acquire(&ptable.lock);
   initProcessLists();
-  initFreeList();
 #ifdef CS333_P4
   ptable.PromoteAtTime = ticks + TICKS_TO_PROMOTE;
 #endif
@@ -210,6 +332,11 @@ void userinit(void)
   if ((p->pgdir = setupkvm()) == 0)
     panic("userinit: out of memory?");
   inituvm(p->pgdir, _binary_initcode_start, (int)_binary_initcode_size);
+  setvdsopid(p->pgdir, p->pid);
+  if (sse2) {
+    fninit();
+    fxsave(FPUSTATE(p));
+  }
   p->sz = PGSIZE;
   memset(p->tf, 0, sizeof(*p->tf));
   p->tf->cs = (SEG_UCODE << 3) | DPL_USER;
@@ -242,8 +369,7 @@ void userinit(void)
   assertState(p, EMBRYO, __FILE__, __LINE__);
   p->state = RUNNABLE;
 #if defined(CS333_P4)
-  stateListAdd(&ptable.ready[p->priority], p);
-  assertState(p, RUNNABLE, __FILE__, __LINE__);
+  readyAdd(p);
 #elif defined(CS333_P3)
   stateListAdd(&ptable.list[RUNNABLE], p);
   assertState(p, RUNNABLE, __FILE__, __LINE__);
@@ -254,27 +380,88 @@ void userinit(void)
 
 // Grow current process's memory by n bytes.
 // Return 0 on success, -1 on failure.
+// Threads share the memory, so all of them see the new size.
+// Shrinking fails while another thread is in a system call,
+// which may be using the memory; see uvmenter().
 int growproc(int n)
 {
   uint sz;
   struct proc *curproc = myproc();
+  struct proc *leader = curproc->thread ? curproc->parent : curproc;
+  struct proc *p;
+
+  // One change at a time to the memory the threads share.
+  acquire(&ptable.lock);
+  while (leader->growing)
+    sleep(&leader->growing, &ptable.lock);
+  leader->growing = n < 0 ? 2 : 1;
+  release(&ptable.lock); // a barrier: threads entering see growing
 
   sz = curproc->sz;
   if (n > 0)
+    sz = allocuvm(curproc->pgdir, sz, sz + n);
+  else if (n < 0)
   {
-    if ((sz = allocuvm(curproc->pgdir, sz, sz + n)) == 0)
-      return -1;
+    if (leader->nsyscall > curproc->inuvm)
+      sz = 0;
+    else
+      sz = shrinkuvm(curproc->pgdir, sz, sz + n);
   }
-  else if (n < 0)
+
+  acquire(&ptable.lock);
+  if (sz != 0)
   {
-    if ((sz = deallocuvm(curproc->pgdir, sz, sz + n)) == 0)
-      return -1;
+    leader->sz = sz;
+    for (p = leader->children; p; p = p->sibling)
+      if (p->thread)
+        p->sz = sz;
   }
-  curproc->sz = sz;
+  leader->growing = 0;
+  wakeup1(&leader->growing);
+  release(&ptable.lock);
+  if (sz == 0)
+    return -1;
   switchuvm(curproc);
   return 0;
 }
 
+// System calls use user memory through pointers that argptr()
+// and friends checked against sz, so growproc() must not free
+// that memory under a thread's system call. syscall() brackets
+// each system call of a process with threads by uvmenter() and
+// uvmleave(), which count it in the process's nsyscall.
+void uvmenter(void)
+{
+  struct proc *curproc = myproc();
+  struct proc *leader;
+
+  // Only a thread can make another, so nthreads is stable at 0.
+  if (!curproc->thread && curproc->nthreads == 0)
+    return;
+  leader = curproc->thread ? curproc->parent : curproc;
+  __sync_fetch_and_add(&leader->nsyscall, 1);
+  curproc->inuvm = 1;
+  // A shrink that began before we were counted may be freeing
+  // memory; wait until it is done and sz is right again.
+  if (leader->growing == 2)
+  {
+    acquire(&ptable.lock);
+    while (leader->growing == 2)
+      sleep(&leader->growing, &ptable.lock);
+    release(&ptable.lock);
+  }
+}
+
+void uvmleave(void)
+{
+  struct proc *curproc = myproc();
+
+  if (!curproc->inuvm)
+    return;
+  curproc->inuvm = 0;
+  __sync_fetch_and_sub(&(curproc->thread ? curproc->parent : curproc)->nsyscall, 1);
+}
+
 // Create a new process copying p as the parent.
 // Sets up stack to return as if from system call.
 // Caller must set state of returned proc to RUNNABLE.
@@ -284,6 +471,7 @@ int fork(void)
   uint pid;
   struct proc *np;
   struct proc *curproc = myproc();
+  struct file **ofile;
 
   // Allocate process.
   if ((np = allocproc()) == 0)
@@ -296,8 +484,9 @@ int fork(void)
   {
     kfree(np->kstack);
     np->kstack = 0;
-#ifdef CS333_P3
     acquire(&ptable.lock);
+    pidhashremove(np);
+#ifdef CS333_P3
     if (stateListRemove(&ptable.list[EMBRYO], np) == -1)
       panic("Error remove from EMBRYO list EMBRYO");
     assertState(np, EMBRYO, __FILE__, __LINE__);
@@ -306,11 +495,18 @@ int fork(void)
 #ifdef CS333_P3
     stateListAdd(&ptable.list[UNUSED], np);
     assertState(np, UNUSED, __FILE__, __LINE__);
-    release(&ptable.lock);
+#else
+    np->next = ptable.unused;
+    ptable.unused = np;
 #endif
+    release(&ptable.lock);
     return -1;
   }
   np->sz = curproc->sz;
+  np->cpumask = curproc->cpumask;
+  setvdsopid(np->pgdir, np->pid);
+  if (sse2)
+    fxsave(FPUSTATE(np)); // the child starts with our user registers
   np->parent = curproc;
 #ifdef CS333_P2
   np->uid = curproc->uid;
@@ -321,9 +517,10 @@ int fork(void)
   // Clear %eax so that fork returns 0 in the child.
   np->tf->eax = 0;
 
+  ofile = procfiles(curproc);
   for (i = 0; i < NOFILE; i++)
-    if (curproc->ofile[i])
-      np->ofile[i] = filedup(curproc->ofile[i]);
+    if (ofile[i])
+      np->ofile[i] = fileget(&ofile[i]);
   np->cwd = idup(curproc->cwd);
 
   safestrcpy(np->name, curproc->name, sizeof(curproc->name));
@@ -331,24 +528,184 @@ int fork(void)
   pid = np->pid;
 
   acquire(&ptable.lock);
+  np->sibling = curproc->children;
+  curproc->children = np;
 #ifdef CS333_P3
   if (stateListRemove(&ptable.list[EMBRYO], np) == -1)
     panic("Error remove from EMBRYO list");
   assertState(np, EMBRYO, __FILE__, __LINE__);
 #endif
   np->state = RUNNABLE;
+  schedlog(SE_ENQUEUE, np, 0);
 #if defined(CS333_P4)
-  stateListAdd(&ptable.ready[np->priority], np);
+  readyAdd(np);
+#elif defined(CS333_P3)
+  stateListAdd(&ptable.list[RUNNABLE], np);
   assertState(np, RUNNABLE, __FILE__, __LINE__);
+#endif
+  kickidle(np);
+  release(&ptable.lock);
+
+  return pid;
+}
+
+// Create a thread that shares this process's memory and runs
+// fcn(arg1, arg2) on the one-page user stack at stack. The new
+// thread is a child of the process that owns the memory, even
+// when another thread calls clone(). It shares the process's
+// open files too, but has its own current directory.
+// Returns the thread's pid, or -1.
+int clone(void (*fcn)(void *, void *), void *arg1, void *arg2, void *stack)
+{
+  uint pid, sp, ustack[3];
+  struct proc *np;
+  struct proc *curproc = myproc();
+  struct proc *leader = curproc->thread ? curproc->parent : curproc;
+
+  if ((uint)stack % PGSIZE != 0 || (uint)stack + PGSIZE > curproc->sz)
+    return -1;
+
+  // Fake return PC, then the arguments, as if fcn were called.
+  sp = (uint)stack + PGSIZE - sizeof(ustack);
+  ustack[0] = 0xffffffff;
+  ustack[1] = (uint)arg1;
+  ustack[2] = (uint)arg2;
+  if (copyout(curproc->pgdir, sp, ustack, sizeof(ustack)) < 0)
+    return -1;
+
+  if ((np = allocproc()) == 0)
+    return -1;
+
+  np->pgdir = curproc->pgdir;
+  np->sz = curproc->sz;
+  np->cpumask = curproc->cpumask;
+  np->thread = 1;
+  np->ustack = stack;
+  if (sse2)
+    fxsave(FPUSTATE(np));
+  np->parent = leader;
+#ifdef CS333_P2
+  np->uid = curproc->uid;
+  np->gid = curproc->gid;
+#endif
+  *np->tf = *curproc->tf;
+  np->tf->eip = (uint)fcn;
+  np->tf->esp = sp;
+
+  np->cwd = idup(curproc->cwd);
+
+  safestrcpy(np->name, curproc->name, sizeof(curproc->name));
+
+  pid = np->pid;
+
+  acquire(&ptable.lock);
+  np->sibling = leader->children;
+  leader->children = np;
+  leader->nthreads++;
+#ifdef CS333_P3
+  if (stateListRemove(&ptable.list[EMBRYO], np) == -1)
+    panic("Error remove from EMBRYO list");
+  assertState(np, EMBRYO, __FILE__, __LINE__);
+#endif
+  np->state = RUNNABLE;
+  schedlog(SE_ENQUEUE, np, 0);
+#if defined(CS333_P4)
+  readyAdd(np);
 #elif defined(CS333_P3)
   stateListAdd(&ptable.list[RUNNABLE], np);
   assertState(np, RUNNABLE, __FILE__, __LINE__);
 #endif
+  kickidle(np);
   release(&ptable.lock);
 
   return pid;
 }
 
+// Wait for another thread of this process to exit and return
+// its pid, storing the stack it was given by clone() in *stack.
+// Return -1 if there are no other threads.
+int join(void **stack)
+{
+  struct proc *p, **pp;
+  int havethreads;
+  uint pid;
+  void *ustack;
+  struct proc *curproc = myproc();
+  struct proc *leader = curproc->thread ? curproc->parent : curproc;
+
+  acquire(&ptable.lock);
+  for (;;)
+  {
+    havethreads = 0;
+    for (pp = &leader->children; (p = *pp) != 0; pp = &p->sibling)
+    {
+      if (!p->thread || p == curproc)
+        continue;
+      havethreads = 1;
+      if (p->state == ZOMBIE)
+      {
+        *pp = p->sibling;
+        pid = p->pid;
+        ustack = p->ustack;
+        reap(p);
+        release(&ptable.lock);
+        *stack = ustack;
+        return pid;
+      }
+    }
+
+    if (!havethreads || curproc->killed)
+    {
+      release(&ptable.lock);
+      return -1;
+    }
+
+    // Thread exit() wakes its parent, the leader.
+    sleep(leader, &ptable.lock);
+  }
+}
+
+// The open file table p uses: a thread's own ofile[] stays
+// empty, and it uses the one of the process it belongs to.
+struct file **
+procfiles(struct proc *p)
+{
+  return p->thread ? p->parent->ofile : p->ofile;
+}
+
+// Kill p's threads and reap them, since they use the memory
+// that p is about to give up. Called by exit() and exec().
+void endthreads(struct proc *curproc)
+{
+  struct proc *p, **pp;
+  int n;
+
+  acquire(&ptable.lock);
+  for (;;)
+  {
+    n = 0;
+    for (pp = &curproc->children; (p = *pp) != 0;)
+    {
+      if (p->thread && p->state == ZOMBIE)
+      {
+        *pp = p->sibling;
+        reap(p);
+        continue;
+      }
+      if (p->thread)
+      {
+        killproc(p);
+        n++;
+      }
+      pp = &p->sibling;
+    }
+    if (n == 0)
+      break;
+    sleep(curproc, &ptable.lock);
+  }
+  release(&ptable.lock);
+}
+
 // Exit the current process.  Does not return.
 // An exited process remains in the zombie state
 // until its parent calls wait() to find out it exited.
@@ -356,12 +713,15 @@ int fork(void)
 void exit(void)
 {
   struct proc *curproc = myproc();
-  struct proc *p;
   int fd;
 
   if (curproc == initproc)
     panic("init exiting");
 
+  uvmleave(); // sys_exit() does not return to syscall()
+  if (!curproc->thread)
+    endthreads(curproc);
+
   // Close all open files.
   for (fd = 0; fd < NOFILE; fd++)
   {
@@ -383,15 +743,7 @@ void exit(void)
   wakeup1(curproc->parent);
 
   // Pass abandoned children to init.
-  for (p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-  {
-    if (p->parent == curproc)
-    {
-      p->parent = initproc;
-      if (p->state == ZOMBIE)
-        wakeup1(initproc);
-    }
-  }
+  reparent(curproc);
 
   // Jump into the scheduler, never to return.
   curproc->state = ZOMBIE;
@@ -405,12 +757,15 @@ void exit(void)
 void exit(void)
 {
   struct proc *curproc = myproc();
-  struct proc *p;
   int fd;
 
   if (curproc == initproc)
     panic("init exiting");
 
+  uvmleave(); // sys_exit() does not return to syscall()
+  if (!curproc->thread)
+    endthreads(curproc);
+
   // Close all open files.
   for (fd = 0; fd < NOFILE; fd++)
   {
@@ -430,40 +785,9 @@ void exit(void)
 
   // Parent might be sleeping in wait().
   wakeup1(curproc->parent);
-#if defined(CS333_P4)
-  for (int i = 0; i < MAXPRIO + 1; i++)
-  {
-    for (p = ptable.ready[i].head; p; p = p->next)
-    {
-      if (p->parent == curproc)
-        p->parent = initproc;
-    }
-  }
-#elif defined(CS333_P3)
-  for (p = ptable.list[RUNNABLE].head; p; p = p->next)
-  {
-    if (p->parent == curproc)
-      p->parent = initproc;
-  }
-#endif
-  for (p = ptable.list[RUNNING].head; p; p = p->next)
-  {
-    if (p->parent == curproc)
-      p->parent = initproc;
-  }
-  for (p = ptable.list[SLEEPING].head; p; p = p->next)
-  {
-    if (p->parent == curproc)
-      p->parent = initproc;
-  }
-  for (p = ptable.list[ZOMBIE].head; p; p = p->next)
-  {
-    if (p->parent == curproc)
-    {
-      p->parent = initproc;
-      wakeup1(initproc);
-    }
-  }
+
+  // Pass abandoned children to init.
+  reparent(curproc);
 
   if (stateListRemove(&ptable.list[RUNNING], curproc) == -1)
     panic("Error occur when remove p from the list RUNNING");
@@ -480,10 +804,10 @@ void exit(void)
 #endif
 // Wait for a child process to exit and return its pid.
 // Return -1 if this process has no children.
-#ifndef CS333_P3
+// Threads are left for join().
 int wait(void)
 {
-  struct proc *p;
+  struct proc *p, **pp;
   int havekids;
   uint pid;
   struct proc *curproc = myproc();
@@ -491,25 +815,19 @@ int wait(void)
   acquire(&ptable.lock);
   for (;;)
   {
-    // Scan through table looking for exited children.
+    // Scan through children looking for exited ones.
     havekids = 0;
-    for (p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+    for (pp = &curproc->children; (p = *pp) != 0; pp = &p->sibling)
     {
-      if (p->parent != curproc)
+      if (p->thread)
         continue;
       havekids = 1;
       if (p->state == ZOMBIE)
       {
         // Found one.
+        *pp = p->sibling;
         pid = p->pid;
-        kfree(p->kstack);
-        p->kstack = 0;
-        freevm(p->pgdir);
-        p->pid = 0;
-        p->parent = 0;
-        p->name[0] = 0;
-        p->killed = 0;
-        p->state = UNUSED;
+        reap(p);
         release(&ptable.lock);
         return pid;
       }
@@ -526,138 +844,54 @@ int wait(void)
     sleep(curproc, &ptable.lock); //DOC: wait-sleep
   }
 }
-#else
-int wait(void)
+//PAGEBREAK: 42
+// Per-CPU process scheduler.
+// Each CPU calls scheduler() after setting itself up.
+// Scheduler never returns.  It loops, doing:
+//  - choose a process to run
+//  - swtch to start running that process
+//  - eventually that process transfers control
+//      via swtch back to the scheduler.
+#ifndef CS333_P3
+void scheduler(void)
 {
   struct proc *p;
-  int havekids;
-  uint pid;
-  struct proc *curproc = myproc();
+  struct cpu *c = mycpu();
+  c->proc = 0;
+#ifdef PDX_XV6
+  int idle; // for checking if processor is idle
+#endif      // PDX_XV6
 
-  acquire(&ptable.lock);
   for (;;)
   {
-    // Scan through table looking for exited children.
-    havekids = 0;
-#if defined(CS333_P4)
-    int i;
-    for (i = 0; i < MAXPRIO + 1; i++)
-    {
-      for (p = ptable.ready[i].head; p; p = p->next)
-      {
-        if (p->parent != curproc)
-          continue;
-        havekids = 1;
-      }
-      if (havekids)
-        break;
-    }
-#elif defined(CS333_P3)
-    for (p = ptable.list[RUNNABLE].head; p; p = p->next)
-    {
-      if (p->parent != curproc)
-        continue;
-      havekids = 1;
-    }
-    for (p = ptable.list[SLEEPING].head; p; p = p->next)
+    // Enable interrupts on this processor.
+    sti();
+
+#ifdef PDX_XV6
+    idle = 1; // assume idle unless we schedule a process
+#endif        // PDX_XV6
+    // Loop over process table looking for process to run.
+    acquire(&ptable.lock);
+    for (p = ptable.all; p; p = p->allnext)
     {
-      if (p->parent != curproc)
+      if (p->state != RUNNABLE || !runhere(p, c - cpus))
         continue;
-      havekids = 1;
-    }
-#endif
-    for (p = ptable.list[RUNNING].head; p; p = p->next)
-    {
-      if (p->parent != curproc)
-        continue;
-      havekids = 1;
-    }
-    for (p = ptable.list[ZOMBIE].head; p; p = p->next)
-    {
-      if (p->parent != curproc)
-      {
-        continue;
-      }
-      else
-      {
-        havekids = 1;
-        // Found one.
-        pid = p->pid;
-        kfree(p->kstack);
-        p->kstack = 0;
-        freevm(p->pgdir);
-        p->pid = 0;
-        p->parent = 0;
-        p->name[0] = 0;
-        p->killed = 0;
-        if (stateListRemove(&ptable.list[ZOMBIE], p) == -1)
-          panic("Error occur when remove p from the list ZOMBIE");
-        assertState(p, ZOMBIE, __FILE__, __LINE__);
-        p->state = UNUSED;
-        stateListAdd(&ptable.list[UNUSED], p);
-        assertState(p, UNUSED, __FILE__, __LINE__);
-        release(&ptable.lock);
-        return pid;
-      }
-    }
-
-    // No point waiting if we don't have any children.
-    if (!havekids || curproc->killed)
-    {
-      release(&ptable.lock);
-      return -1;
-    }
-
-    // Wait for children to exit.  (See wakeup1 call in proc_exit.)
-    sleep(curproc, &ptable.lock); //DOC: wait-sleep
-  }
-}
-#endif
-//PAGEBREAK: 42
-// Per-CPU process scheduler.
-// Each CPU calls scheduler() after setting itself up.
-// Scheduler never returns.  It loops, doing:
-//  - choose a process to run
-//  - swtch to start running that process
-//  - eventually that process transfers control
-//      via swtch back to the scheduler.
-#ifndef CS333_P3
-void scheduler(void)
-{
-  struct proc *p;
-  struct cpu *c = mycpu();
-  c->proc = 0;
-#ifdef PDX_XV6
-  int idle; // for checking if processor is idle
-#endif      // PDX_XV6
-
-  for (;;)
-  {
-    // Enable interrupts on this processor.
-    sti();
-
-#ifdef PDX_XV6
-    idle = 1; // assume idle unless we schedule a process
-#endif        // PDX_XV6
-    // Loop over process table looking for process to run.
-    acquire(&ptable.lock);
-    for (p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-    {
-      if (p->state != RUNNABLE)
-        continue;
-
-        // Switch to chosen process.  It is the process's job
-        // to release ptable.lock and then reacquire it
-        // before jumping back to us.
-#ifdef PDX_XV6
-      idle = 0; // not idle this timeslice
-#endif          // PDX_XV6
-      c->proc = p;
-      switchuvm(p);
-      p->state = RUNNING;
-#ifdef CS333_P2
-      p->cpu_ticks_in = ticks; // check in when process run in cpu
+
+        // Switch to chosen process.  It is the process's job
+        // to release ptable.lock and then reacquire it
+        // before jumping back to us.
+#ifdef PDX_XV6
+      idle = 0; // not idle this timeslice
+#endif          // PDX_XV6
+      c->proc = p;
+      runon(p, c - cpus);
+      switchuvm(p);
+      p->state = RUNNING;
+#ifdef CS333_P2
+      p->cpu_ticks_in = ticks; // check in when process run in cpu
+      p->cpu_cycles_in = rdtsc();
 #endif
+      schedlog(SE_DISPATCH, p, c - cpus);
       swtch(&(c->scheduler), p->context);
       switchkvm();
 
@@ -665,13 +899,24 @@ void scheduler(void)
       // It should have changed its p->state before coming back.
       c->proc = 0;
     }
+#ifdef PDX_XV6
+    // if idle, wait for next interrupt: a tick, or an IPI from
+    // kickidle(). Interrupts stay off until the hlt, so a kick
+    // cannot come in between and be missed.
+    if (idle)
+    {
+      c->idle = 1;
+      pushcli();
+    }
+#endif // PDX_XV6
     release(&ptable.lock);
 #ifdef PDX_XV6
-    // if idle, wait for next interrupt
     if (idle)
     {
-      sti();
-      hlt();
+      stihlt();
+      cli();
+      c->idle = 0;
+      popcli();
     }
 #endif // PDX_XV6
   }
@@ -695,92 +940,50 @@ void scheduler(void)
 #endif // PDX_XV6
     acquire(&ptable.lock);
 #ifdef CS333_P4
-    struct proc *next;
-    if (ticks >= ptable.PromoteAtTime && MAXPRIO)
+    int i;
+    if (ticks >= ptable.PromoteAtTime && MAXPRIO &&
+        ptable.policy == SCHED_MLFQ)
     {
-      for (int i = MAXPRIO; i >= 0; i--)
-      {
-        p = ptable.ready[i].head;
-        while (p)
-        {
-          if (i == MAXPRIO)
-          {
-            p->budget = DEFAULT_BUDGET;
-            p = p->next;
-          }
-          else
-          {
-            next = p->next;
-            stateListRemove(&ptable.ready[p->priority], p);
-            assertState(p, RUNNABLE, __FILE__, __LINE__);
-            p->priority += 1;
-            stateListAdd(&ptable.ready[p->priority], p);
-            assertState(p, RUNNABLE, __FILE__, __LINE__);
-            p->budget = DEFAULT_BUDGET;
-            p = next;
-          }
-        }
-      }
-      for (p = ptable.list[SLEEPING].head; p; p = p->next)
-      {
-        if (p->priority == MAXPRIO)
-        {
-          p->budget = DEFAULT_BUDGET;
-        }
-        else
-        {
-          p->priority += 1;
-          p->budget = DEFAULT_BUDGET;
-        }
-      }
-      for (p = ptable.list[RUNNING].head; p; p = p->next)
-      {
-        if (p->priority == MAXPRIO)
-        {
-          p->budget = DEFAULT_BUDGET;
-        }
-        else
-        {
-          p->priority += 1;
-          p->budget = DEFAULT_BUDGET;
-        }
-      }
-      cprintf("Promoted all jobs!\n");
+      // Promote everyone by moving each ready list up a level,
+      // which takes time in MAXPRIO rather than in the number of
+      // processes. Each process's priority and budget catch up in
+      // promote() the next time the scheduler touches it.
+      for (i = MAXPRIO - 1; i >= 0; i--)
+        stateListAppend(&ptable.ready[i + 1], &ptable.ready[i]);
+      ptable.epoch++;
       ptable.PromoteAtTime = ticks + TICKS_TO_PROMOTE;
     }
 #endif
 
 #if defined(CS333_P4)
-    int i;
-    for (i = MAXPRIO; i >= 0; i--)
+    if ((p = readyPop(c - cpus)) != 0)
     {
-      if (ptable.ready[i].head)
-      {
 #ifdef PDX_XV6
-        idle = 0; // not idle this timeslice
+      idle = 0; // not idle this timeslice
 #endif // PDX_XV6
-        p = ptable.ready[i].head;
-        c->proc = p;
-        switchuvm(p);
-        stateListRemove(&ptable.ready[p->priority], p);
-        assertState(p, RUNNABLE, __FILE__, __LINE__);
-        p->state = RUNNING;
-        stateListAdd(&ptable.list[RUNNING], p);
-        assertState(p, RUNNING, __FILE__, __LINE__);
+      c->proc = p;
+      runon(p, c - cpus);
+      switchuvm(p);
+      assertState(p, RUNNABLE, __FILE__, __LINE__);
+      p->state = RUNNING;
+      stateListAdd(&ptable.list[RUNNING], p);
+      assertState(p, RUNNING, __FILE__, __LINE__);
 #ifdef CS333_P2
-        p->cpu_ticks_in = ticks; // check in when process run in cpu
+      p->cpu_ticks_in = ticks; // check in when process run in cpu
+      p->cpu_cycles_in = rdtsc();
 #endif
-        swtch(&(c->scheduler), p->context);
-        switchkvm();
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-        break; //done select the highest priority process, get out
-      }
+      schedlog(SE_DISPATCH, p, c - cpus);
+      swtch(&(c->scheduler), p->context);
+      switchkvm();
+      // Process is done running for now.
+      // It should have changed its p->state before coming back.
+      c->proc = 0;
     }
 #elif defined(CS333_P3)
     for (p = ptable.list[RUNNABLE].head; p; p = p->next)
     {
+      if (!runhere(p, c - cpus))
+        continue;
       // Switch to chosen process.  It is the process's job
       // to release ptable.lock and then reacquire it
       // before jumping back to us.
@@ -788,6 +991,7 @@ void scheduler(void)
       idle = 0; // not idle this timeslice
 #endif // PDX_XV6
       c->proc = p;
+      runon(p, c - cpus);
       switchuvm(p);
       if (stateListRemove(&ptable.list[RUNNABLE], p) == -1)
         panic("Error occur when remove p from the list RUNNABLE");
@@ -797,7 +1001,9 @@ void scheduler(void)
       assertState(p, RUNNING, __FILE__, __LINE__);
 #ifdef CS333_P2
       p->cpu_ticks_in = ticks; // check in when process run in cpu
+      p->cpu_cycles_in = rdtsc();
 #endif
+      schedlog(SE_DISPATCH, p, c - cpus);
       swtch(&(c->scheduler), p->context);
       switchkvm();
       // Process is done running for now.
@@ -805,14 +1011,23 @@ void scheduler(void)
       c->proc = 0;
     }
 #endif
+#ifdef PDX_XV6
+    // if idle, wait for next interrupt; see above
+    if (idle)
+    {
+      c->idle = 1;
+      pushcli();
+    }
+#endif // PDX_XV6
     release(&ptable.lock);
 
 #ifdef PDX_XV6
-    // if idle, wait for next interrupt
     if (idle)
     {
-      sti();
-      hlt();
+      stihlt();
+      cli();
+      c->idle = 0;
+      popcli();
     }
 #endif // PDX_XV6
   }
@@ -841,9 +1056,17 @@ void sched(void)
     panic("sched interruptible");
   intena = mycpu()->intena;
 #ifdef CS333_P2
-  p->cpu_ticks_total += (ticks - p->cpu_ticks_in); // total = total + current tick - time when enter cpu
+  p->cpu_cycles_total += rdtsc() - p->cpu_cycles_in;
 #endif
+  if (sse2)
+    fxsave(FPUSTATE(p));
+  p->offcpu = ticks;
+  mycpu()->needresched = 0;
+  schedlog(p->state == SLEEPING ? SE_SLEEP :
+           p->state == ZOMBIE ? SE_EXIT : SE_YIELD, p, 0);
   swtch(&p->context, mycpu()->scheduler);
+  if (sse2)
+    fxrstor(FPUSTATE(p));
   mycpu()->intena = intena;
 }
 
@@ -870,21 +1093,8 @@ void yield(void)
   curproc->state = RUNNABLE;
 
 #if defined(CS333_P4)
-  stateListAdd(&ptable.ready[curproc->priority], curproc);
-  assertState(curproc, RUNNABLE, __FILE__, __LINE__);
-  if (MAXPRIO)
-  {
-    curproc->budget -= (ticks - curproc->cpu_ticks_in);
-    if ((curproc->budget <= 0) && (curproc->priority != 0))
-    {
-      stateListRemove(&ptable.ready[curproc->priority], curproc);
-      assertState(curproc, RUNNABLE, __FILE__, __LINE__);
-      curproc->priority -= 1;
-      stateListAdd(&ptable.ready[curproc->priority], curproc);
-      assertState(curproc, RUNNABLE, __FILE__, __LINE__);
-      curproc->budget = DEFAULT_BUDGET;
-    }
-  }
+  charge(curproc);
+  readyAdd(curproc);
 #elif defined(CS333_P3)
   stateListAdd(&ptable.list[RUNNABLE], curproc);
   assertState(curproc, RUNNABLE, __FILE__, __LINE__);
@@ -901,6 +1111,9 @@ void forkret(void)
   // Still holding ptable.lock from scheduler.
   release(&ptable.lock);
 
+  if (sse2)
+    fxrstor(FPUSTATE(myproc()));
+
   if (first)
   {
     // Some initialization functions must be run in the context
@@ -980,15 +1193,7 @@ void sleep(void *chan, struct spinlock *lk)
   assertState(p, RUNNING, __FILE__, __LINE__);
 
 #ifdef CS333_P4
-  if (MAXPRIO)
-  {
-    p->budget -= (ticks - p->cpu_ticks_in);
-    if ((p->budget <= 0) && (p->priority != 0))
-    {
-      p->priority -= 1;
-      p->budget = DEFAULT_BUDGET;
-    }
-  }
+  charge(p);
 #endif
   p->state = SLEEPING;
   stateListAdd(&ptable.list[SLEEPING], p);
@@ -1017,9 +1222,13 @@ wakeup1(void *chan)
 {
   struct proc *p;
 
-  for (p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+  for (p = ptable.all; p; p = p->allnext)
     if (p->state == SLEEPING && p->chan == chan)
+    {
       p->state = RUNNABLE;
+      schedlog(SE_WAKEUP, p, 0);
+      kickidle(p);
+    }
 }
 #else
 static void wakeup1(void *chan)
@@ -1036,12 +1245,14 @@ static void wakeup1(void *chan)
         panic("Error occur when remove p from the list SLEEPING");
       assertState(p, SLEEPING, __FILE__, __LINE__);
       p->state = RUNNABLE;
+      schedlog(SE_WAKEUP, p, 0);
 #if defined(CS333_P4)
-      stateListAdd(&ptable.ready[p->priority], p);
-      assertState(p, RUNNABLE, __FILE__, __LINE__);
+      readyAdd(p);
+      preempt(p);
 #elif defined(CS333_P3)
       stateListAdd(&ptable.list[RUNNABLE], p);
       assertState(p, RUNNABLE, __FILE__, __LINE__);
+      kickidle(p);
 #endif
     }
     p = next;
@@ -1058,90 +1269,20 @@ void wakeup(void *chan)
 // Kill the process with the given pid.
 // Process won't exit until it returns
 // to user space (see trap in trap.c).
-#ifndef CS333_P3
-int kill(int pid)
-{
-  struct proc *p;
-
-  acquire(&ptable.lock);
-  for (p = ptable.proc; p < &ptable.proc[NPROC]; p++)
-  {
-    if (p->pid == pid)
-    {
-      p->killed = 1;
-      // Wake process from sleep if necessary.
-      if (p->state == SLEEPING)
-        p->state = RUNNABLE;
-      release(&ptable.lock);
-      return 0;
-    }
-  }
-  release(&ptable.lock);
-  return -1;
-}
-#else
 int kill(int pid)
 {
   struct proc *p;
 
   acquire(&ptable.lock);
-  for (p = ptable.list[SLEEPING].head; p; p = p->next)
-  {
-    if (p->pid == pid)
-    {
-      p->killed = 1;
-      if (stateListRemove(&ptable.list[SLEEPING], p) == -1)
-        panic("Error occur when remove p from the list SLEEPING");
-      assertState(p, SLEEPING, __FILE__, __LINE__);
-      p->state = RUNNABLE;
-#if defined(CS333_P4)
-      stateListAdd(&ptable.ready[p->priority], p);
-      assertState(p, RUNNABLE, __FILE__, __LINE__);
-#elif defined(CS333_P3)
-      stateListAdd(&ptable.list[RUNNABLE], p);
-      assertState(p, RUNNABLE, __FILE__, __LINE__);
-#endif
-      release(&ptable.lock);
-      return 0;
-    }
-  }
-#if defined(CS333_P4)
-  for (int i = 0; i < MAXPRIO + 1; i++)
-  {
-    for (p = ptable.ready[i].head; p; p = p->next)
-    {
-      if (p->pid == pid)
-      {
-        p->killed = 1;
-        release(&ptable.lock);
-        return 0;
-      }
-    }
-  }
-#elif defined(CS333_P3)
-  for (p = ptable.list[RUNNABLE].head; p; p = p->next)
-  {
-    if (p->pid == pid)
-    {
-      p->killed = 1;
-    }
-    release(&ptable.lock);
-    return 0;
-  }
-#endif
-  for (p = ptable.list[RUNNING].head; p; p = p->next)
+  if ((p = pidlookup(pid)) == 0)
   {
-    if (p->pid == pid)
-    {
-      p->killed = 1;
-    }
     release(&ptable.lock);
-    return 0;
+    return -1;
   }
+  killproc(p);
   release(&ptable.lock);
-  return -1;
+  return 0;
 }
-#endif
 
 //PAGEBREAK: 36
 // Print a process listing to console.  For debugging.
@@ -1153,14 +1294,15 @@ int kill(int pid)
 void procdumpP4(struct proc *p, char *state_string)
 {
   int MAXNAME = 13;
-  uint zero;
+  uint zero, cpums, cpuus;
   char *eslaped = "", *cpu_time = "";
   zero = (ticks - p->start_ticks) % 1000;
   if (zero < 100 && zero >= 10)
     eslaped = "0";
   else if (zero < 10)
     eslaped = "00";
-  zero = p->cpu_ticks_total % 1000;
+  cyclestime(p->cpu_cycles_total, &cpums, &cpuus);
+  zero = cpums % 1000;
   if (zero < 100 && zero >= 10)
     cpu_time = "0";
   else if (zero < 10)
@@ -1169,13 +1311,25 @@ void procdumpP4(struct proc *p, char *state_string)
   int len = strlen(p->name);
   for (int i = len; i < MAXNAME; i++)
     cprintf(" ");
-  cprintf("%d\t        %d\t%d\t%d\t%d.%s%d\t%d.%s%d\t%s\t%d\t", p->uid, p->gid, p->parent ? p->parent->pid : p->pid, p->priority, (ticks - p->start_ticks) / 1000, eslaped, (ticks - p->start_ticks) % 1000, p->cpu_ticks_total / 1000, cpu_time, p->cpu_ticks_total % 1000, state_string, p->sz);
+  cprintf("%d\t        %d\t%d\t%d\t%d.%s%d\t%d.%s%d\t%s\t%d\t", p->uid, p->gid, p->parent ? p->parent->pid : p->pid, curpriority(p), (ticks - p->start_ticks) / 1000, eslaped, (ticks - p->start_ticks) % 1000, cpums / 1000, cpu_time, cpums % 1000, state_string, p->sz);
   return;
 }
 void runnabledump(void)
 {
   struct proc *p;
   acquire(&ptable.lock);
+  if (ptable.policy == SCHED_CFS)
+  {
+    cprintf("CFS shares (uid,weight,vruntime,ready):\n");
+    for (int i = 0; i < ptable.nshare; i++)
+      cprintf("(%d,%d,%d,%d)\n", ptable.shares[i].uid,
+              ptable.shares[i].weight,
+              (uint)(ptable.shares[i].vruntime >> 10),
+              ptable.shares[i].nready);
+    cprintf("\n$");
+    release(&ptable.lock);
+    return;
+  }
   cprintf("Ready List in Ready List Processes:\n");
   for (int i = MAXPRIO; i >= 0; i--)
   {
@@ -1183,7 +1337,8 @@ void runnabledump(void)
     for (p = ptable.ready[i].head; p; p = p->next)
     {
       assertState(p, RUNNABLE, __FILE__, __LINE__);
-      cprintf("(%d,%d)", p->pid, p->budget);
+      cprintf("(%d,%d)", p->pid,
+              p->epoch == ptable.epoch ? p->budget : BUDGET);
       if (p->next)
         cprintf("->");
     }
@@ -1245,14 +1400,15 @@ void zombiedump(void)
 void procdumpP3(struct proc *p, char *state_string)
 {
   int MAXNAME = 10;
-  uint zero;
+  uint zero, cpums, cpuus;
   char *eslaped = "", *cpu_time = "";
   zero = (ticks - p->start_ticks) % 1000;
   if (zero < 100 && zero >= 10)
     eslaped = "0";
   else if (zero < 10)
     eslaped = "00";
-  zero = p->cpu_ticks_total % 1000;
+  cyclestime(p->cpu_cycles_total, &cpums, &cpuus);
+  zero = cpums % 1000;
   if (zero < 100 && zero >= 10)
     cpu_time = "0";
   else if (zero < 10)
@@ -1261,7 +1417,7 @@ void procdumpP3(struct proc *p, char *state_string)
   int len = strlen(p->name);
   for (int i = len; i < MAXNAME; i++)
     cprintf(" ");
-  cprintf(" %d\t        %d \t%d\t%d.%s%d\t%d.%s%d\t%s\t%d\t", p->uid, p->gid, p->parent ? p->parent->pid : p->pid, (ticks - p->start_ticks) / 1000, eslaped, (ticks - p->start_ticks) % 1000, p->cpu_ticks_total / 1000, cpu_time, p->cpu_ticks_total % 1000, state_string, p->sz);
+  cprintf(" %d\t        %d \t%d\t%d.%s%d\t%d.%s%d\t%s\t%d\t", p->uid, p->gid, p->parent ? p->parent->pid : p->pid, (ticks - p->start_ticks) / 1000, eslaped, (ticks - p->start_ticks) % 1000, cpums / 1000, cpu_time, cpums % 1000, state_string, p->sz);
   return;
 }
 void runnabledump(void)
@@ -1335,14 +1491,15 @@ void zombiedump(void)
 void procdumpP2(struct proc *p, char *state_string)
 {
   int MAXNAME = 12;
-  uint zero;
+  uint zero, cpums, cpuus;
   char *eslaped = "", *cpu_time = "";
   zero = (ticks - p->start_ticks) % 1000;
   if (zero < 100 && zero >= 10)
     eslaped = "0";
   else if (zero < 10)
     eslaped = "00";
-  zero = p->cpu_ticks_total % 1000;
+  cyclestime(p->cpu_cycles_total, &cpums, &cpuus);
+  zero = cpums % 1000;
   if (zero < 100 && zero >= 10)
     cpu_time = "0";
   else if (zero < 10)
@@ -1351,7 +1508,7 @@ void procdumpP2(struct proc *p, char *state_string)
   int len = strlen(p->name);
   for (int i = len; i < MAXNAME; i++)
     cprintf(" ");
-  cprintf(" %d\t        %d \t%d\t%d.%s%d\t%d.%s%d\t%s\t%d\t", p->uid, p->gid, p->parent ? p->parent->pid : p->pid, (ticks - p->start_ticks) / 1000, eslaped, (ticks - p->start_ticks) % 1000, p->cpu_ticks_total / 1000, cpu_time, p->cpu_ticks_total % 1000, state_string, p->sz);
+  cprintf(" %d\t        %d \t%d\t%d.%s%d\t%d.%s%d\t%s\t%d\t", p->uid, p->gid, p->parent ? p->parent->pid : p->pid, (ticks - p->start_ticks) / 1000, eslaped, (ticks - p->start_ticks) % 1000, cpums / 1000, cpu_time, cpums % 1000, state_string, p->sz);
   return;
 }
 
@@ -1389,7 +1546,7 @@ void procdump(void)
 
   cprintf(HEADER); // not conditionally compiled as must work in all project states
 
-  for (p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+  for (p = ptable.all; p; p = p->allnext)
   {
     if (p->state == UNUSED)
       continue;
@@ -1520,24 +1677,15 @@ initProcessLists()
     ptable.ready[i].head = NULL;
     ptable.ready[i].tail = NULL;
   }
+  ptable.nshare = 0;
+  sharefor(0);
+  ptable.rt.head = NULL;
+  ptable.rt.tail = NULL;
+  ptable.policy = SCHED_DEFAULT;
 #endif
 }
 #endif
 
-#if defined(CS333_P3)
-static void
-initFreeList(void)
-{
-  struct proc *p;
-
-  for (p = ptable.proc; p < ptable.proc + NPROC; ++p)
-  {
-    p->state = UNUSED;
-    stateListAdd(&ptable.list[UNUSED], p);
-  }
-}
-#endif
-
 #if defined(CS333_P3)
 // example usage:
 // assertState(p, UNUSED, __FUNCTION__, __LINE__);
@@ -1554,12 +1702,44 @@ assertState(struct proc *p, enum procstate state, const char *func, int line)
 }
 #endif
 #ifdef CS333_P2
+// Split TSC cycles into milliseconds and the microseconds left
+// over. Both are 0 until the TSC is calibrated; see trap().
+static void
+cyclestime(uint64 cycles, uint *ms, uint *us)
+{
+  uint rem;
+
+  *ms = *us = 0;
+  if (tscpertick == 0)
+    return;
+  *ms = divu64(divu64(cycles * USPERTICK, tscpertick, &rem), 1000, us);
+}
+
+// CPU time of the current process and of the children it has
+// waited for.
+int cputime(struct cputime *ct)
+{
+  struct proc *curproc = myproc();
+  uint64 self, children;
+
+  acquire(&ptable.lock);
+  self = curproc->cpu_cycles_total + rdtsc() - curproc->cpu_cycles_in;
+  children = curproc->cpu_cycles_children;
+  release(&ptable.lock);
+  cyclestime(self, &ct->ms, &ct->us);
+  cyclestime(children, &ct->children_ms, &ct->children_us);
+  return 0;
+}
+
+// Holding pidlock for reading stops processes from being
+// created or reaped, without blocking the scheduler; the
+// other fields are copied as they happen to be.
 int getprocs(uint max, struct uproc *table)
 {
   struct proc *p;
   int i = 0;
-  acquire(&ptable.lock);
-  for (p = ptable.proc; p < &ptable.proc[NPROC]; p++)
+  acquireread(&ptable.pidlock);
+  for (p = ptable.all; p; p = p->allnext)
   {
     if (i == max)
       break;
@@ -1574,63 +1754,663 @@ int getprocs(uint max, struct uproc *table)
     table[i].gid = p->gid;
     table[i].ppid = p->parent ? p->parent->pid : p->pid;
     table[i].elapsed_ticks = ticks - p->start_ticks;
-    table[i].CPU_total_ticks = p->cpu_ticks_total;
+    cyclestime(p->cpu_cycles_total, &table[i].CPU_total_ticks,
+               &table[i].CPU_total_usec);
     table[i].size = p->sz;
+    table[i].migrations = p->migrations;
 #ifdef CS333_P4
-    table[i].priority = p->priority;
+    table[i].priority = curpriority(p);
 #endif
     safestrcpy(table[i].name, p->name, STRMAX);
     i++;
   }
 
-  release(&ptable.lock);
+  releaseread(&ptable.pidlock);
   return i;
 }
 #endif
 #ifdef CS333_P4
-int setpriority(int pid, int priority)
+// Move all of from onto the end of to.
+static void
+stateListAppend(struct ptrs *to, struct ptrs *from)
 {
-  acquire(&ptable.lock);
-  struct proc *p;
-  int onReadyList = 0;
-  for (p = ptable.list[SLEEPING].head; p; p = p->next)
-  {
-    if (p->pid == pid)
-      goto found;
-  }
+  if (from->head == NULL)
+    return;
+  if (to->head == NULL)
+    to->head = from->head;
+  else
+    to->tail->next = from->head;
+  to->tail = from->tail;
+  from->head = NULL;
+  from->tail = NULL;
+}
 
-  for (p = ptable.list[RUNNING].head; p; p = p->next)
+// p's priority counting the promotions it has missed since
+// p->epoch. A RUNNABLE process is on ready[curpriority(p)].
+static int
+curpriority(struct proc *p)
+{
+  uint missed = ptable.epoch - p->epoch;
+
+  if (missed >= MAXPRIO - p->priority)
+    return MAXPRIO;
+  return p->priority + missed;
+}
+
+// Apply the promotions p has missed: raise its priority and
+// give it a fresh budget. Must come before p's priority is used
+// or p is added to a ready list. Caller holds ptable.lock.
+static void
+promote(struct proc *p)
+{
+  if (p->epoch == ptable.epoch)
+    return;
+  if (curpriority(p) != p->priority)
+    schedlog(SE_PROMOTE, p, curpriority(p));
+  p->priority = curpriority(p);
+  p->budget = BUDGET;
+  p->epoch = ptable.epoch;
+}
+
+// CFS weights for nice 0 to 19, as in Linux: each step down
+// gets about 1/1.25 as much CPU. Priorities below MAXPRIO map
+// to CFS_NICESTEP nice levels apiece.
+static int cfsweights[] = {
+    1024, 820, 655, 526, 423, 335, 272, 215, 172, 137,
+    110, 87, 70, 56, 45, 36, 29, 23, 18, 15};
+
+static int
+cfsweight(struct proc *p)
+{
+  int nice = (MAXPRIO - p->priority) * CFS_NICESTEP;
+
+  if (nice >= NELEM(cfsweights))
+    nice = NELEM(cfsweights) - 1;
+  return cfsweights[nice];
+}
+
+// Merge two leftist heaps of RUNNABLE procs ordered on vruntime.
+// The right spines are O(log n) long, and so is the recursion.
+static struct proc *
+cfsmerge(struct proc *a, struct proc *b)
+{
+  struct proc *t;
+
+  if (a == 0)
+    return b;
+  if (b == 0)
+    return a;
+  if (b->vruntime < a->vruntime)
   {
-    if (p->pid == pid)
-      goto found;
+    t = a;
+    a = b;
+    b = t;
   }
-  int i;
-  for (i = 0; i < MAXPRIO + 1; i++)
+  a->cfsright = cfsmerge(a->cfsright, b);
+  if (a->cfsleft == 0 || a->cfsleft->cfsrank < a->cfsright->cfsrank)
   {
-    for (p = ptable.ready[i].head; p; p = p->next)
-    {
-      if (p->pid == pid)
-      {
-        onReadyList = 1;
-        goto found;
-      }
-    }
+    t = a->cfsleft;
+    a->cfsleft = a->cfsright;
+    a->cfsright = t;
   }
-  release(&ptable.lock);
-  return -1;
+  a->cfsrank = a->cfsright ? a->cfsright->cfsrank + 1 : 1;
+  return a;
+}
 
-found:
-  if (onReadyList)
+// The share for uid, making one if need be. A share whose weight
+// is the default and that has nothing ready can be taken over by
+// another uid. If every share is busy, uid falls in with uid 0.
+static struct share *
+sharefor(uint uid)
+{
+  struct share *s, *spare;
+
+  spare = 0;
+  for (s = ptable.shares; s < &ptable.shares[ptable.nshare]; s++)
   {
-    stateListRemove(&ptable.ready[p->priority], p);
-    p->priority = priority;
+    if (s->uid == uid)
+      return s;
+    if (spare == 0 && s->nready == 0 && s->weight == DEFAULT_SHARE &&
+        s != ptable.shares)
+      spare = s;
+  }
+  if (ptable.nshare < NSHARE)
+    spare = &ptable.shares[ptable.nshare++];
+  if (spare == 0)
+    return ptable.shares;
+  spare->uid = uid;
+  spare->weight = DEFAULT_SHARE;
+  spare->nready = 0;
+  spare->ready = 0;
+  spare->vruntime = ptable.minvruntime;
+  spare->minvruntime = 0;
+  return spare;
+}
+
+// p's share, looked up again if p changed uid or the share was
+// taken over since p last used it.
+static struct share *
+procshare(struct proc *p)
+{
+  if (p->share == 0 || p->share->uid != p->uid)
+    p->share = sharefor(p->uid);
+  return p->share;
+}
+
+// Make RUNNABLE p ready to be picked by readyPop(). Under CFS a
+// share or process that slept for a while comes back at most
+// CFS_SLACK behind the others, so it cannot monopolize the CPU
+// catching up. Caller holds ptable.lock.
+static void
+readyAdd(struct proc *p)
+{
+  struct share *s;
+
+  promote(p);
+  if (p->rtperiod)
+  {
+    rtupdate(p);
+    rtinsert(p);
+  }
+  else if (ptable.policy == SCHED_CFS)
+  {
+    s = procshare(p);
+    if (s->nready++ == 0 && s->vruntime + CFS_SLACK < ptable.minvruntime)
+      s->vruntime = ptable.minvruntime - CFS_SLACK;
+    if (p->vruntime + CFS_SLACK < s->minvruntime)
+      p->vruntime = s->minvruntime - CFS_SLACK;
+    p->cfsleft = 0;
+    p->cfsright = 0;
+    p->cfsrank = 1;
+    s->ready = cfsmerge(s->ready, p);
+  }
+  else
+    stateListAdd(&ptable.ready[p->priority], p);
+  assertState(p, RUNNABLE, __FILE__, __LINE__);
+}
+
+// Take the process in s with the least vruntime that runhere()
+// allows on cpu, or 0.
+static struct proc *
+cfspick(struct share *s, int cpu)
+{
+  struct proc *p, *skipped, *next;
+
+  skipped = 0;
+  while ((p = s->ready) != 0)
+  {
+    s->ready = cfsmerge(p->cfsleft, p->cfsright);
+    if (runhere(p, cpu))
+      break;
+    p->cfsleft = skipped;
+    skipped = p;
+  }
+  for (; skipped; skipped = next)
+  {
+    next = skipped->cfsleft;
+    skipped->cfsleft = 0;
+    skipped->cfsright = 0;
+    skipped->cfsrank = 1;
+    s->ready = cfsmerge(s->ready, skipped);
+  }
+  if (p)
+    s->nready--;
+  return p;
+}
+
+// Take the next process for the CPU numbered cpu (any, if -1)
+// off the ready lists, or 0. Real-time processes with time left
+// in their reservation come first, earliest deadline first.
+// Then the first runhere() allows in the highest non-empty ready
+// list under MLFQ. CFS picks the share
+// with the least vruntime, then its process with the least, so
+// each uid gets CPU in proportion to its weight however many
+// processes it has. Caller holds ptable.lock.
+static struct proc *
+readyPop(int cpu)
+{
+  struct share *s, *best;
+  struct proc *p;
+  char tried[NSHARE];
+  int i;
+
+  // Start new periods for those whose deadlines have passed.
+  while ((p = ptable.rt.head) != 0 && ticks >= p->deadline)
+  {
+    stateListRemove(&ptable.rt, p);
+    rtupdate(p);
+    rtinsert(p);
+  }
+  for (p = ptable.rt.head; p; p = p->next)
+  {
+    if (p->rtleft > 0 && (cpu < 0 || (p->cpumask & (1 << cpu))))
+    {
+      stateListRemove(&ptable.rt, p);
+      return p;
+    }
+  }
+
+  if (ptable.policy == SCHED_CFS)
+  {
+    memset(tried, 0, ptable.nshare);
+    for (;;)
+    {
+      best = 0;
+      for (s = ptable.shares; s < &ptable.shares[ptable.nshare]; s++)
+        if (s->nready && !tried[s - ptable.shares] &&
+            (best == 0 || s->vruntime < best->vruntime))
+          best = s;
+      if (best == 0)
+        return 0;
+      if ((p = cfspick(best, cpu)) != 0)
+        break;
+      tried[best - ptable.shares] = 1;
+    }
+    if (p->vruntime > best->minvruntime)
+      best->minvruntime = p->vruntime;
+    if (best->vruntime > ptable.minvruntime)
+      ptable.minvruntime = best->vruntime;
+    return p;
+  }
+  for (i = MAXPRIO; i >= 0; i--)
+  {
+    for (p = ptable.ready[i].head; p; p = p->next)
+    {
+      if (runhere(p, cpu))
+      {
+        promote(p);
+        stateListRemove(&ptable.ready[p->priority], p);
+        return p;
+      }
+    }
+  }
+  return 0;
+}
+
+// Microseconds the RUNNING process p has run since it was last
+// switched in, by the TSC once that is calibrated.
+static uint
+ranus(struct proc *p)
+{
+  uint rem;
+
+  if (tscpertick == 0)
+    return (ticks - p->cpu_ticks_in) * USPERTICK;
+  return divu64((rdtsc() - p->cpu_cycles_in) * USPERTICK, tscpertick, &rem);
+}
+
+// Charge the RUNNING process p for the time it has just run.
+// A real-time process spends its reservation, in ticks. MLFQ
+// takes microseconds from its budget and demotes it when that
+// runs out; CFS adds them to the vruntime of p and of its share,
+// each scaled by its weight. Caller holds ptable.lock.
+static void
+charge(struct proc *p)
+{
+  uint ran = ranus(p);
+  uint rant = ticks - p->cpu_ticks_in;
+  struct share *s;
+
+  promote(p);
+  if (p->rtperiod)
+  {
+    p->rtleft = rant >= p->rtleft ? 0 : p->rtleft - rant;
+    rtupdate(p);
+    return;
+  }
+  if (ptable.policy == SCHED_CFS)
+  {
+    p->vruntime += (uint64)ran * ((CFS_NICE0 << 10) / cfsweight(p));
+    s = procshare(p);
+    s->vruntime += (uint64)ran * ((CFS_NICE0 << 10) / s->weight);
+    return;
+  }
+  if (MAXPRIO && !p->boosted)
+  {
+    p->budget -= ran;
+    if ((p->budget <= 0) && (p->priority != 0))
+    {
+      p->priority -= 1;
+      p->budget = BUDGET;
+      schedlog(SE_DEMOTE, p, p->priority);
+    }
+  }
+}
+
+// Switch every CPU to scheduling policy, moving the RUNNABLE
+// processes over. Returns the old policy, or -1.
+int setscheduler(int policy)
+{
+  struct ptrs moved;
+  struct proc *p, *next;
+  int old;
+
+  if (policy != SCHED_MLFQ && policy != SCHED_CFS)
+    return -1;
+  acquire(&ptable.lock);
+  old = ptable.policy;
+  moved.head = NULL;
+  moved.tail = NULL;
+  while ((p = readyPop(-1)) != 0)
+    stateListAdd(&moved, p);
+  ptable.policy = policy;
+  for (p = moved.head; p; p = next)
+  {
+    next = p->next;
+    readyAdd(p);
+  }
+  release(&ptable.lock);
+  return old;
+}
+
+// Set uid's CPU weight under CFS, relative to DEFAULT_SHARE.
+// Returns -1 if there is no room for another share.
+int setshare(uint uid, int weight)
+{
+  struct share *s;
+
+  acquire(&ptable.lock);
+  s = sharefor(uid);
+  if (s->uid != uid)
+  {
+    release(&ptable.lock);
+    return -1;
+  }
+  s->weight = weight;
+  release(&ptable.lock);
+  return 0;
+}
+
+// Start any periods of p's reservation that are due, counting
+// a deadline miss for each whose job p did not finish in time.
+static void
+rtupdate(struct proc *p)
+{
+  uint n;
+
+  if (ticks < p->deadline)
+    return;
+  n = (ticks - p->deadline) / p->rtperiod + 1;
+  p->rtmisses += p->rtdone ? n - 1 : n;
+  p->rtdone = 0;
+  p->rtleft = p->rtruntime;
+  p->deadline += n * p->rtperiod;
+}
+
+// Add real-time p to ptable.rt in deadline order.
+static void
+rtinsert(struct proc *p)
+{
+  struct proc **pp;
+
+  for (pp = &ptable.rt.head; *pp && (*pp)->deadline <= p->deadline;
+       pp = &(*pp)->next)
+    ;
+  p->next = *pp;
+  *pp = p;
+  if (p->next == NULL)
+    ptable.rt.tail = p;
+}
+
+// Give the calling process a real-time reservation of runtime
+// ticks in every period ticks, with each period's end as its
+// deadline, or take it away if runtime is 0. Returns -1 if the
+// reservation cannot be guaranteed alongside the others.
+int setdeadline(int runtime, int period)
+{
+  struct proc *curproc = myproc();
+  struct proc *p;
+  int u, total, umax;
+
+  if (runtime < 0 || period <= 0 || runtime > period ||
+      period > RT_MAXPERIOD)
+    return -1;
+  acquire(&ptable.lock);
+  if (runtime > 0)
+  {
+    total = umax = runtime * RT_UNIT / period;
+    for (p = ptable.all; p; p = p->allnext)
+    {
+      if (p == curproc || p->rtperiod == 0 || p->state == UNUSED ||
+          p->state == ZOMBIE)
+        continue;
+      u = p->rtruntime * RT_UNIT / p->rtperiod;
+      total += u;
+      if (u > umax)
+        umax = u;
+    }
+    // Global EDF on ncpu CPUs meets every deadline when the
+    // total utilization is at most ncpu - (ncpu - 1) * umax
+    // (Goossens, Funk and Baruah).
+    if (total > ncpu * RT_UNIT - (ncpu - 1) * umax)
+    {
+      release(&ptable.lock);
+      return -1;
+    }
+  }
+  curproc->rtruntime = runtime;
+  curproc->rtperiod = runtime ? period : 0;
+  curproc->rtleft = runtime;
+  curproc->deadline = ticks + period;
+  curproc->rtdone = 0;
+  release(&ptable.lock);
+  return 0;
+}
+
+// Finish the calling real-time process's job for this period
+// and sleep until the next one starts. A job that is already
+// late starts its next period at once. Returns the number of
+// deadlines missed so far, or -1 if not real-time.
+int rtwait(void)
+{
+  struct proc *curproc = myproc();
+  uint deadline;
+  int misses;
+
+  acquire(&ptable.lock);
+  if (curproc->rtperiod == 0)
+  {
+    release(&ptable.lock);
+    return -1;
+  }
+  deadline = curproc->deadline;
+  rtupdate(curproc);
+  if (curproc->deadline == deadline)
+  {
+    curproc->rtdone = 1;
+    while (ticks < deadline && !curproc->killed)
+      sleep(&ticks, &ptable.lock);
+  }
+  misses = curproc->rtmisses;
+  release(&ptable.lock);
+  return misses;
+}
+
+// Whether running process p should give up the CPU before the
+// end of its slice: it is real-time and has used its reservation
+// or reached its deadline, or a real-time process with an earlier
+// deadline is waiting. Called on each clock tick without the
+// lock, so it may be wrong; yield() sorts it out.
+int rtpreempt(struct proc *p)
+{
+  struct proc *q = ptable.rt.head;
+
+  if (p->rtperiod && (ticks - p->cpu_ticks_in >= p->rtleft ||
+                      ticks >= p->deadline))
+    return 1;
+  return q && q->rtleft > 0 && (!p->rtperiod || q->deadline < p->deadline);
+}
+
+// Whether p should run in place of q: real-time processes with
+// reservation left come first, earliest deadline first, then
+// MLFQ priority. CFS leaves wakeups to the next tick.
+static int
+outranks(struct proc *p, struct proc *q)
+{
+  if (p->rtperiod || q->rtperiod)
+    return p->rtperiod && p->rtleft > 0 &&
+           (!q->rtperiod || p->deadline < q->deadline);
+  return ptable.policy == SCHED_MLFQ && curpriority(p) > curpriority(q);
+}
+
+// Get p, just woken up, running without waiting for the next
+// timer tick: wake an idle CPU it may run on, or else have the
+// CPU running the least process p outranks reschedule. An IPI
+// tells another CPU; trap() checks needresched on the way out.
+// Caller holds ptable.lock.
+static void
+preempt(struct proc *p)
+{
+  struct cpu *c, *best;
+  struct proc *q;
+
+  if (kickidle(p))
+    return;
+  best = 0;
+  for (c = cpus; c < cpus + ncpu; c++)
+  {
+    if (!(p->cpumask & (1 << (c - cpus))) || (q = c->proc) == 0)
+      continue;
+    if (outranks(p, q) && (best == 0 || outranks(best->proc, q)))
+      best = c;
+  }
+  if (best == 0)
+    return;
+  best->needresched = 1;
+  if (best != mycpu())
+    lapicipi(best->apicid, T_RESCHED);
+}
+
+// Raise p to priority prio, if it is lower, until it releases
+// its sleeplocks. Returns whether p was raised.
+// Caller holds ptable.lock.
+static int
+boost(struct proc *p, int prio)
+{
+  promote(p);
+  if (p->priority >= prio)
+    return 0;
+  if (!p->boosted)
+  {
+    p->boosted = 1;
+    p->baseprio = p->priority;
+    p->baseepoch = ptable.epoch;
+  }
+  if (p->state == RUNNABLE && !p->rtperiod && ptable.policy == SCHED_MLFQ)
+  {
+    stateListRemove(&ptable.ready[p->priority], p);
+    p->priority = prio;
+    stateListAdd(&ptable.ready[p->priority], p);
+  }
+  else
+    p->priority = prio;
+  return 1;
+}
+
+// The caller is about to sleep until lk's holder releases it.
+// Lend the caller's priority to the holder, and on down the
+// chain of holders that are themselves waiting for sleeplocks,
+// so a mid-priority process cannot keep the holder, and so the
+// caller, off the CPU. Caller holds lk->lk.
+void sleeplockwait(struct sleeplock *lk)
+{
+  struct proc *curproc = myproc();
+  struct proc *p;
+  int prio, depth;
+
+  acquire(&ptable.lock);
+  promote(curproc);
+  prio = curproc->priority;
+  curproc->blockedon = lk;
+  for (depth = 0; lk && depth < PI_MAXDEPTH; depth++)
+  {
+    // Further down the chain lk->lk is not held, but waitprio
+    // is only a hint for sleeplockunboost().
+    if (prio > lk->waitprio)
+      lk->waitprio = prio;
+    if ((p = pidlookup(lk->pid)) == 0 || !boost(p, prio))
+      break;
+    lk = p->blockedon;
+  }
+  release(&ptable.lock);
+}
+
+// The caller has released a sleeplock: drop any priority it
+// inherited to what the waiters on the locks it still holds
+// call for. Caller holds the released lock's lk.
+void sleeplockunboost(void)
+{
+  struct proc *curproc = myproc();
+  struct sleeplock *lk;
+  int want, base;
+  uint missed;
+
+  if (!curproc->boosted)
+    return;
+  want = -1;
+  for (lk = curproc->held; lk; lk = lk->nextheld)
+    if (lk->waitprio > want)
+      want = lk->waitprio;
+  acquire(&ptable.lock);
+  // The base priority, with the promotions since the boost.
+  missed = ptable.epoch - curproc->baseepoch;
+  if (missed >= MAXPRIO - curproc->baseprio)
+    base = MAXPRIO;
+  else
+    base = curproc->baseprio + missed;
+  if (want > base)
+  {
+    promote(curproc);
+    if (want < curproc->priority)
+      curproc->priority = want;
+  }
+  else
+  {
+    curproc->boosted = 0;
+    curproc->priority = curproc->baseprio;
+    curproc->epoch = curproc->baseepoch;
+    promote(curproc);
+  }
+  release(&ptable.lock);
+}
+
+int setpriority(int pid, int priority)
+{
+  struct proc *p;
+
+  acquire(&ptable.lock);
+  p = pidlookup(pid);
+  if (p == 0 || (p->state != SLEEPING && p->state != RUNNING &&
+                 p->state != RUNNABLE))
+  {
+    release(&ptable.lock);
+    return -1;
+  }
+  promote(p);
+  if (p->boosted)
+  {
+    // Keep an inherited priority that is higher until the boost ends.
+    p->baseprio = priority;
+    p->baseepoch = ptable.epoch;
+    if (priority <= p->priority)
+    {
+      p->budget = BUDGET;
+      release(&ptable.lock);
+      return 0;
+    }
+    p->boosted = 0;
+  }
+  if (p->state == RUNNABLE && !p->rtperiod && ptable.policy == SCHED_MLFQ)
+  {
+    stateListRemove(&ptable.ready[p->priority], p);
+    p->priority = priority;
     stateListAdd(&ptable.ready[p->priority], p);
   }
   else
   {
     p->priority = priority;
   }
-  p->budget = DEFAULT_BUDGET;
+  p->budget = BUDGET;
   release(&ptable.lock);
   return 0;
 }
@@ -1638,15 +2418,239 @@ int getpriority(int pid)
 {
   struct proc *p;
   int priority = -1;
-  acquire(&ptable.lock);
-  for (int i = 0; i < statecount; i++)
-    for (p = ptable.list[i].head; p; p = p->next)
+  acquireread(&ptable.pidlock);
+  if ((p = pidlookup(pid)) != 0)
+    priority = curpriority(p);
+  releaseread(&ptable.pidlock);
+  return priority;
+}
+#endif
+
+// Hash chain for pid.
+static struct proc **
+pidchain(int pid)
+{
+  return &ptable.pidhash[pid & (NPIDHASH - 1)];
+}
+
+// Make p findable by pidlookup(). Caller holds ptable.lock.
+static void
+pidhashinsert(struct proc *p)
+{
+  struct proc **h = pidchain(p->pid);
+
+  acquirewrite(&ptable.pidlock);
+  p->hnext = *h;
+  *h = p;
+  releasewrite(&ptable.pidlock);
+}
+
+// Undo pidhashinsert(). Caller holds ptable.lock.
+static void
+pidhashremove(struct proc *p)
+{
+  struct proc **pp;
+
+  acquirewrite(&ptable.pidlock);
+  for (pp = pidchain(p->pid); *pp; pp = &(*pp)->hnext)
+  {
+    if (*pp == p)
+    {
+      *pp = p->hnext;
+      p->hnext = 0;
+      releasewrite(&ptable.pidlock);
+      return;
+    }
+  }
+  panic("pidhashremove");
+}
+
+// Return the process with the given pid, or 0 if none.
+// Caller holds ptable.lock, or ptable.pidlock for reading if
+// it only looks at the process. Changes to pidhash take both.
+static struct proc *
+pidlookup(int pid)
+{
+  struct proc *p;
+
+  for (p = *pidchain(pid); p; p = p->hnext)
+    if (p->pid == pid)
+      return p;
+  return 0;
+}
+
+// Pass all children of curproc to init, in O(children).
+// Caller holds ptable.lock.
+static void
+reparent(struct proc *curproc)
+{
+  struct proc *p;
+
+  if ((p = curproc->children) == 0)
+    return;
+  for (;;)
+  {
+    p->parent = initproc;
+    if (p->state == ZOMBIE)
+      wakeup1(initproc);
+    if (p->sibling == 0)
+      break;
+    p = p->sibling;
+  }
+  p->sibling = initproc->children;
+  initproc->children = curproc->children;
+  curproc->children = 0;
+}
+
+// Whether the CPU numbered cpu (any CPU, if -1) should run p.
+// p->cpumask is a hard limit. As a soft one, p is left to the
+// CPU it last ran on, whose cache may still hold its working
+// set, until it has been off that CPU for AFFINITY_WAIT ticks.
+static int
+runhere(struct proc *p, int cpu)
+{
+  if (cpu < 0)
+    return 1;
+  if (!(p->cpumask & (1 << cpu)))
+    return 0;
+  return p->lastcpu < 0 || p->lastcpu == cpu ||
+         ticks - p->offcpu >= AFFINITY_WAIT;
+}
+
+// Record that p is about to run on the CPU numbered cpu.
+static void
+runon(struct proc *p, int cpu)
+{
+  if (p->lastcpu >= 0 && p->lastcpu != cpu)
+    p->migrations++;
+  p->lastcpu = cpu;
+}
+
+// Wake an idle CPU that may run p, just made RUNNABLE, instead
+// of leaving p until that CPU's next timer tick. Returns whether
+// there was one. Caller holds ptable.lock.
+static int
+kickidle(struct proc *p)
+{
+  struct cpu *c;
+
+  for (c = cpus; c < cpus + ncpu; c++)
+    if (c->idle && runhere(p, c - cpus))
     {
-      if (p->pid == pid)
-        if (i != 0) // pid found not in UNUSED list
-          priority = p->priority;
+      c->idle = 0;
+      if (c != mycpu())
+        lapicipi(c->apicid, T_RESCHED);
+      return 1;
     }
+  return 0;
+}
+
+// Limit process pid to the CPUs in mask. A process that is no
+// longer allowed where it is running moves at its next yield;
+// the caller does so at once.
+int setaffinity(int pid, uint mask)
+{
+  struct proc *p;
+  int moved;
+
+  mask &= (1 << ncpu) - 1;
+  if (mask == 0)
+    return -1;
+  acquire(&ptable.lock);
+  if ((p = pidlookup(pid)) == 0 || p->state == ZOMBIE)
+  {
+    release(&ptable.lock);
+    return -1;
+  }
+  p->cpumask = mask;
   release(&ptable.lock);
-  return priority;
+  if (p == myproc())
+  {
+    pushcli();
+    moved = !(mask & (1 << cpuid()));
+    popcli();
+    if (moved)
+      yield();
+  }
+  return 0;
+}
+
+// The CPUs process pid may run on, or -1.
+int getaffinity(int pid)
+{
+  struct proc *p;
+  int mask = -1;
+
+  acquireread(&ptable.pidlock);
+  if ((p = pidlookup(pid)) != 0)
+    mask = p->cpumask & ((1 << ncpu) - 1);
+  releaseread(&ptable.pidlock);
+  return mask;
 }
+
+// Mark p killed and wake it from sleep if necessary.
+// Caller holds ptable.lock.
+static void
+killproc(struct proc *p)
+{
+  p->killed = 1;
+  if (p->state == SLEEPING)
+  {
+#ifdef CS333_P3
+    if (stateListRemove(&ptable.list[SLEEPING], p) == -1)
+      panic("Error occur when remove p from the list SLEEPING");
+    assertState(p, SLEEPING, __FILE__, __LINE__);
 #endif
+    p->state = RUNNABLE;
+    schedlog(SE_WAKEUP, p, 0);
+#if defined(CS333_P4)
+    readyAdd(p);
+#elif defined(CS333_P3)
+    stateListAdd(&ptable.list[RUNNABLE], p);
+    assertState(p, RUNNABLE, __FILE__, __LINE__);
+#endif
+    kickidle(p);
+  }
+}
+
+// Free zombie p, which its parent has already unlinked from
+// its children. The memory stays if p is a thread.
+// Caller holds ptable.lock.
+static void
+reap(struct proc *p)
+{
+  pidhashremove(p);
+#ifdef CS333_P2
+  // A thread's time is its process's own.
+  if (p->thread)
+    p->parent->cpu_cycles_total += p->cpu_cycles_total;
+  else
+    p->parent->cpu_cycles_children += p->cpu_cycles_total + p->cpu_cycles_children;
+#endif
+  if (p->thread)
+    p->parent->nthreads--;
+  kfree(p->kstack);
+  p->kstack = 0;
+  if (!p->thread)
+    freevm(p->pgdir);
+  p->pgdir = 0;
+  p->pid = 0;
+  p->parent = 0;
+  p->name[0] = 0;
+  p->killed = 0;
+  p->thread = 0;
+  p->ustack = 0;
+#ifdef CS333_P3
+  if (stateListRemove(&ptable.list[ZOMBIE], p) == -1)
+    panic("Error occur when remove p from the list ZOMBIE");
+  assertState(p, ZOMBIE, __FILE__, __LINE__);
+#endif
+  p->state = UNUSED;
+#ifdef CS333_P3
+  stateListAdd(&ptable.list[UNUSED], p);
+  assertState(p, UNUSED, __FILE__, __LINE__);
+#else
+  p->next = ptable.unused;
+  ptable.unused = p;
+#endif
+}
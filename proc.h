@@ -9,6 +9,8 @@ struct cpu
   int ncli;                  // Depth of pushcli nesting.
   int intena;                // Were interrupts enabled before pushcli?
   struct proc *proc;         // The process running on this cpu or null
+  volatile int needresched;  // proc should yield; see trap()
+  volatile int idle;         // halted for want of work; see kickidle()
 };
 
 extern struct cpu cpus[NCPU];
@@ -61,21 +63,59 @@ struct proc
   struct inode *cwd;          // Current directory
   char name[16];              // Process name (debugging)
   uint start_ticks;           // Time when process start
+  struct proc *allnext;       // Next process in ptable.all
+  struct proc *hnext;         // Next process in the same pid hash chain
+  struct proc *children;      // First child process
+  struct proc *sibling;       // Next child of the same parent
+  char fpu[512+16];           // User x87/SSE registers; see FPUSTATE
+  int thread;                 // If non-zero, shares parent's pgdir (clone)
+  void *ustack;               // User stack given to clone(), for join()
+  int nthreads;               // Threads it has, if not a thread itself
+  struct file *fheld;         // File argfd() holds for this system call
+  int growing;                // growproc() running: 1, or 2 if shrinking
+  int nsyscall;               // Its threads in system calls; see uvmenter()
+  int inuvm;                  // Counted in its process's nsyscall
+  uint cpumask;               // CPUs it may run on; see runhere()
+  int lastcpu;                // CPU it last ran on, or -1
+  uint offcpu;                // ticks when it last left lastcpu
+  uint migrations;            // Times it has run on a new CPU
+  uint *futex;                // If non-zero, futex word waited on
+  struct proc *fnext;         // Next waiter in the same futex queue
 #ifdef CS333_P2
   uint uid; // UID
   uint gid; // GID
-  uint cpu_ticks_total;
-  uint cpu_ticks_in;
-#endif
-#ifdef CS333_P3
-  struct proc *next;
+  uint cpu_ticks_in;           // ticks when it last started running
+  uint64 cpu_cycles_in;       // and the TSC then
+  uint64 cpu_cycles_total;    // TSC cycles it has run
+  uint64 cpu_cycles_children; // cycles of its reaped children
 #endif
+  struct proc *next;          // Next in its state list (UNUSED only, without P3)
 #ifdef CS333_P4
   int priority;
-  int budget;
+  int budget;      // microseconds left at this priority
+  uint epoch; // ptable.epoch when priority was last brought up to date
+  uint64 vruntime; // CFS virtual runtime, in 1/1024ths of a nice-0 microsecond
+  struct share *share; // CFS share of this uid; see procshare()
+  struct proc *cfsleft; // children in the share's ready heap
+  struct proc *cfsright;
+  int cfsrank;          // length of the heap's right spine from here
+  int rtruntime;        // real-time reservation: rtruntime ticks
+  int rtperiod;         // in every rtperiod, or 0 if not real-time
+  uint deadline;        // end of the current period
+  uint rtleft;          // ticks of the reservation left this period
+  int rtdone;           // finished this period's job (rtwait)
+  uint rtmisses;        // deadlines passed with the job unfinished
+  int boosted;          // priority raised by a sleeplock waiter
+  int baseprio;         // priority and epoch to go back to
+  uint baseepoch;       // when the boost ends
+  struct sleeplock *held;      // exclusive sleeplocks held
+  struct sleeplock *blockedon; // sleeplock waited for, or 0
 #endif
 };
 
+// fxsave area inside p->fpu, which need not be 16-byte aligned.
+#define FPUSTATE(p) ((void*)(((uint)(p)->fpu + 15) & ~15))
+
 // Process memory is laid out contiguously, low addresses first:
 //   text
 //   original data and bss
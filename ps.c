@@ -2,15 +2,38 @@
 #include "user.h"
 #include "types.h"
 #include "uproc.h"
-#define MAX 6
 #define MAXNAME 12
+
+// Fetch the whole process table, growing the buffer until
+// getprocs() no longer fills it.
+static struct uproc *
+fetchprocs(int *num_procs)
+{
+    struct uproc *proc;
+    int max = 64;
+
+    for (;;)
+    {
+        proc = malloc(sizeof(struct uproc) * max);
+        if (proc == 0)
+        {
+            printf(2, "ps: out of memory\n");
+            exit();
+        }
+        *num_procs = getprocs(max, proc);
+        if (*num_procs < max)
+            return proc;
+        free(proc);
+        max *= 2;
+    }
+}
 #endif
 int main(void)
 {
 #if defined(CS333_P4)
-    struct uproc *proc = malloc(sizeof(struct uproc) * MAX);
-    int num_procs = getprocs(16, proc);
-    printf(1, "PID\tName         UID\tGID\tPPID\tPrio\tElapsed\tCPU\tState\tSize\n");
+    int num_procs;
+    struct uproc *proc = fetchprocs(&num_procs);
+    printf(1, "PID\tName         UID\tGID\tPPID\tPrio\tElapsed\tCPU\t\tState\tSize\tMigr\n");
     for (int i = 0; i < num_procs; i++)
     {
         uint zero;
@@ -29,13 +52,13 @@ int main(void)
         int len = strlen(proc[i].name);
         for (int j = len; j < MAXNAME; j++)
             printf(1, " ");
-        printf(1, " %d\t        %d \t%d\t%d\t%d.%s%d\t%d.%s%d\t%s\t%d\n", proc[i].uid, proc[i].gid, proc[i].ppid, proc[i].priority, proc[i].elapsed_ticks / 1000, eslaped, proc[i].elapsed_ticks % 1000, proc[i].CPU_total_ticks / 1000, cpu, proc[i].CPU_total_ticks % 1000, proc[i].state, proc[i].size);
+        printf(1, " %d\t        %d \t%d\t%d\t%d.%s%d\t%d.%s%d%s%d\t%s\t%d\t%d\n", proc[i].uid, proc[i].gid, proc[i].ppid, proc[i].priority, proc[i].elapsed_ticks / 1000, eslaped, proc[i].elapsed_ticks % 1000, proc[i].CPU_total_ticks / 1000, cpu, proc[i].CPU_total_ticks % 1000, pad3(proc[i].CPU_total_usec), proc[i].CPU_total_usec, proc[i].state, proc[i].size, proc[i].migrations);
     }
     free(proc);
 #elif defined(CS333_P2)
-    struct uproc *proc = malloc(sizeof(struct uproc) * MAX);
-    int num_procs = getprocs(16, proc);
-    printf(1, "PID\tName         UID\tGID\tPPID\tElapsed\tCPU\tState\tSize\n");
+    int num_procs;
+    struct uproc *proc = fetchprocs(&num_procs);
+    printf(1, "PID\tName         UID\tGID\tPPID\tElapsed\tCPU\t\tState\tSize\tMigr\n");
     for (int i = 0; i < num_procs; i++)
     {
         uint zero;
@@ -54,7 +77,7 @@ int main(void)
         int len = strlen(proc[i].name);
         for (int j = len; j < MAXNAME; j++)
             printf(1, " ");
-        printf(1, " %d\t        %d \t%d\t%d.%s%d\t%d.%s%d\t%s\t%d\n", proc[i].uid, proc[i].gid, proc[i].ppid, proc[i].elapsed_ticks / 1000, eslaped, proc[i].elapsed_ticks % 1000, proc[i].CPU_total_ticks / 1000, cpu, proc[i].CPU_total_ticks % 1000, proc[i].state, proc[i].size);
+        printf(1, " %d\t        %d \t%d\t%d.%s%d\t%d.%s%d%s%d\t%s\t%d\t%d\n", proc[i].uid, proc[i].gid, proc[i].ppid, proc[i].elapsed_ticks / 1000, eslaped, proc[i].elapsed_ticks % 1000, proc[i].CPU_total_ticks / 1000, cpu, proc[i].CPU_total_ticks % 1000, pad3(proc[i].CPU_total_usec), proc[i].CPU_total_usec, proc[i].state, proc[i].size, proc[i].migrations);
     }
     free(proc);
 #endif
@@ -0,0 +1,59 @@
+// Sum an array with 1, 2, 4 and 8 threads and report how long
+// each takes.
+
+#include "types.h"
+#include "user.h"
+
+#define N (1024*1024)
+#define REPS 20
+
+int *a;
+int nthread;
+int partial[8];
+
+void
+worker(void *arg1, void *arg2)
+{
+  int i, r, t, sum;
+  int lo, hi;
+
+  t = (int)arg1;
+  lo = N / nthread * t;
+  hi = N / nthread * (t + 1);
+  sum = 0;
+  for(r = 0; r < REPS; r++)
+    for(i = lo; i < hi; i++)
+      sum += a[i];
+  partial[t] = sum;
+  exit();
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i, sum, t0;
+
+  if((a = malloc(N * sizeof(a[0]))) == 0){
+    printf(2, "psum: out of memory\n");
+    exit();
+  }
+  for(i = 0; i < N; i++)
+    a[i] = i & 0xff;
+
+  printf(1, "threads\tticks\tsum\n");
+  for(nthread = 1; nthread <= 8; nthread *= 2){
+    t0 = uptime();
+    for(i = 0; i < nthread; i++)
+      if(thread_create(worker, (void*)i, 0) < 0){
+        printf(2, "psum: thread_create failed\n");
+        exit();
+      }
+    for(i = 0; i < nthread; i++)
+      thread_join();
+    sum = 0;
+    for(i = 0; i < nthread; i++)
+      sum += partial[i];
+    printf(1, "%d\t%d\t%d\n", nthread, uptime() - t0, sum);
+  }
+  exit();
+}
@@ -0,0 +1,141 @@
+// Test the real-time scheduling class: admission control on
+// reservations, that only root may make them, and deadline
+// misses of a periodic job run while schedstress keeps the CPUs
+// busy, with and without a reservation.
+#ifdef CS333_P4
+#include "types.h"
+#include "user.h"
+
+#define PERIOD 20 // ticks
+#define RUNTIME 5 // ticks reserved per period
+#define WORK 2    // ticks of work per job
+#define JOBS 100
+
+// Spin for WORK ticks of wall-clock time.
+void
+work(void)
+{
+  int t0 = uptime();
+
+  while(uptime() - t0 < WORK)
+    ;
+}
+
+// The periodic job as an ordinary process: count the jobs that
+// end after the end of their period.
+int
+besteffort(void)
+{
+  int i, release, misses;
+
+  misses = 0;
+  release = uptime();
+  for(i = 0; i < JOBS; i++){
+    work();
+    if(uptime() > release + PERIOD)
+      misses++;
+    release += PERIOD;
+    if(uptime() < release)
+      sleep(release - uptime());
+  }
+  return misses;
+}
+
+// The same job under a real-time reservation.
+int
+realtime(void)
+{
+  int i, misses;
+
+  if(setdeadline(RUNTIME, PERIOD) < 0){
+    printf(2, "rttest: setdeadline failed\n");
+    exit();
+  }
+  misses = 0;
+  for(i = 0; i < JOBS; i++){
+    work();
+    misses = rtwait();
+  }
+  setdeadline(0, 0);
+  return misses;
+}
+
+// A reservation of a whole CPU leaves no room under global EDF
+// for another one.
+int
+admission(void)
+{
+  int pid, fds[2], ok;
+  char c;
+
+  if(setdeadline(PERIOD, PERIOD) < 0)
+    return 0;
+  pipe(fds);
+  pid = fork();
+  if(pid == 0){
+    c = setdeadline(PERIOD, PERIOD) < 0 && setdeadline(1, 2) < 0;
+    write(fds[1], &c, 1);
+    exit();
+  }
+  ok = read(fds[0], &c, 1) == 1 && c;
+  wait();
+  close(fds[0]);
+  close(fds[1]);
+  setdeadline(0, 0);
+  return ok && setdeadline(-1, PERIOD) < 0 && setdeadline(2, 1) < 0;
+}
+
+// Only root may make a reservation.
+int
+rootonly(void)
+{
+  int pid, fds[2], ok;
+  char c;
+
+  pipe(fds);
+  pid = fork();
+  if(pid == 0){
+    c = setuid(1) == 0 && setdeadline(1, PERIOD) < 0;
+    write(fds[1], &c, 1);
+    exit();
+  }
+  ok = read(fds[0], &c, 1) == 1 && c;
+  wait();
+  close(fds[0]);
+  close(fds[1]);
+  return ok;
+}
+
+int
+main(void)
+{
+  char *argv[] = { "schedstress", "5", 0 };
+  int pid, be, rt, ok;
+
+  ok = admission();
+  printf(1, "rttest: admission control %s\n", ok ? "ok" : "FAILED");
+  if(!rootonly()){
+    printf(1, "rttest: reservation by non-root allowed\n");
+    ok = 0;
+  }
+
+  pid = fork();
+  if(pid == 0){
+    exec(argv[0], argv);
+    printf(2, "rttest: exec schedstress failed\n");
+    exit();
+  }
+  sleep(100);
+  be = besteffort();
+  rt = realtime();
+  printf(1, "rttest: %d jobs of %d ticks every %d ticks under load\n",
+         JOBS, WORK, PERIOD);
+  printf(1, "  best effort: %d deadlines missed\n", be);
+  printf(1, "  real-time (%d/%d): %d deadlines missed\n", RUNTIME, PERIOD, rt);
+  if(rt > 0)
+    ok = 0;
+  wait();
+  printf(1, "rttest: %s\n", ok ? "PASS" : "FAIL");
+  exit();
+}
+#endif
@@ -0,0 +1,61 @@
+// Reader-writer spin locks.
+// Like spin locks, they disable interrupts while held, and the
+// holder must not sleep.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "x86.h"
+#include "rwlock.h"
+
+void
+initrwlock(struct rwlock *rw, char *name)
+{
+  rw->name = name;
+  rw->state = 0;
+  rw->wwait = 0;
+}
+
+void
+acquireread(struct rwlock *rw)
+{
+  uint s;
+
+  pushcli();
+  for(;;){
+    s = *(volatile uint*)&rw->state;
+    if(!(s & RW_WRITER) && *(volatile uint*)&rw->wwait == 0 &&
+       __sync_bool_compare_and_swap(&rw->state, s, s + 1))
+      break;
+    pause();
+  }
+}
+
+void
+releaseread(struct rwlock *rw)
+{
+  if(rw->state == 0 || (rw->state & RW_WRITER))
+    panic("releaseread");
+  __sync_fetch_and_sub(&rw->state, 1);
+  popcli();
+}
+
+void
+acquirewrite(struct rwlock *rw)
+{
+  pushcli();
+  __sync_fetch_and_add(&rw->wwait, 1);
+  while(!__sync_bool_compare_and_swap(&rw->state, 0, RW_WRITER))
+    pause();
+  __sync_fetch_and_sub(&rw->wwait, 1);
+}
+
+void
+releasewrite(struct rwlock *rw)
+{
+  if(rw->state != RW_WRITER)
+    panic("releasewrite");
+  __sync_synchronize();
+  rw->state = 0;
+  popcli();
+}
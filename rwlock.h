@@ -0,0 +1,9 @@
+// Reader-writer spin lock: any number of readers, or one writer.
+// A waiting writer keeps new readers out, so writers cannot starve.
+struct rwlock {
+  uint state;        // RW_WRITER, or the number of readers.
+  uint wwait;        // Writers waiting to acquire.
+  char *name;        // Name of lock.
+};
+
+#define RW_WRITER 0x80000000
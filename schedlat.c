@@ -0,0 +1,241 @@
+// Trace the scheduler while a command runs, or for a second,
+// and print histograms of each process's times: running before
+// it gave up the CPU, waiting runnable to be dispatched, and
+// sleeping before a wakeup.
+//
+// usage: schedlat [command [arg ...]]
+
+#include "types.h"
+#include "user.h"
+#include "x86.h"
+#include "schedtrace.h"
+
+#define NEV (8 * NSCHEDTRACE)
+#define NPID 64
+#define NBUCKET 20      // log2 microsecond buckets; the last is open-ended
+#define DRAIN 10        // ticks between drains
+#define DEFTICKS 1000   // ticks to trace without a command
+
+// What a process was last seen doing.
+#define UNKNOWN  0
+#define RUNNING  1
+#define WAITING  2
+#define SLEEPING 3
+
+// Histograms.
+#define RUN   0
+#define WAIT  1
+#define SLEEP 2
+
+struct pstat {
+  int pid;
+  int state;
+  uint64 since;   // TSC when it entered state
+  uint prio;      // priority changes
+  uint hist[3][NBUCKET];
+};
+
+struct schedevent ev[NEV];
+struct pstat pstat[NPID];
+uint cyclesperus;
+uint lost;
+
+// Time the TSC against uptime() for 100 ticks.
+void
+calibrate(void)
+{
+  uint64 t;
+  int u0, u1;
+
+  u0 = uptime();
+  while(uptime() == u0)
+    ;
+  t = rdtsc();
+  u0 = uptime();
+  sleep(100);
+  u1 = uptime();
+  cyclesperus = (uint)(rdtsc() - t) / ((u1 - u0) * 1000);
+  if(cyclesperus == 0)
+    cyclesperus = 1;
+}
+
+struct pstat*
+lookup(int pid)
+{
+  struct pstat *p;
+
+  for(p = pstat; p < &pstat[NPID]; p++)
+    if(p->pid == pid)
+      return p;
+  for(p = pstat; p < &pstat[NPID]; p++)
+    if(p->pid == 0){
+      p->pid = pid;
+      return p;
+    }
+  return 0;
+}
+
+// Count the time from p->since to now in histogram h.
+void
+record(struct pstat *p, int h, uint64 now)
+{
+  uint us;
+  int b;
+
+  if(now < p->since)
+    return;
+  if((now - p->since) >> 32)
+    b = NBUCKET - 1;
+  else {
+    us = (uint)(now - p->since) / cyclesperus;
+    for(b = 0; us && b < NBUCKET - 1; b++)
+      us >>= 1;
+  }
+  p->hist[h][b]++;
+}
+
+// Account for event e. Returns whether it is pid's exit.
+int
+handle(struct schedevent *e, int pid)
+{
+  struct pstat *p;
+
+  if(e->type == SE_LOST){
+    // Intervals across the gap would be wrong.
+    lost += e->arg;
+    for(p = pstat; p < &pstat[NPID]; p++)
+      p->state = UNKNOWN;
+    return 0;
+  }
+  if((p = lookup(e->pid)) == 0)
+    return 0;
+  switch(e->type){
+  case SE_ENQUEUE:
+    p->state = WAITING;
+    break;
+  case SE_WAKEUP:
+    if(p->state == SLEEPING)
+      record(p, SLEEP, e->tsc);
+    p->state = WAITING;
+    break;
+  case SE_DISPATCH:
+    if(p->state == WAITING)
+      record(p, WAIT, e->tsc);
+    p->state = RUNNING;
+    break;
+  case SE_YIELD:
+  case SE_SLEEP:
+  case SE_EXIT:
+    if(p->state == RUNNING)
+      record(p, RUN, e->tsc);
+    p->state = e->type == SE_YIELD ? WAITING :
+               e->type == SE_SLEEP ? SLEEPING : UNKNOWN;
+    break;
+  case SE_PROMOTE:
+  case SE_DEMOTE:
+    p->prio++;
+    return 0;
+  }
+  p->since = e->tsc;
+  return e->type == SE_EXIT && e->pid == pid;
+}
+
+// Drain the kernel's rings and account for the events in the
+// order they happened. Returns whether pid exited.
+int
+drain(int pid)
+{
+  struct schedevent t;
+  int i, j, n, done;
+
+  n = schedtrace(ev, NEV);
+  // Batches are small, and each CPU's events come in order.
+  for(i = 1; i < n; i++)
+    for(j = i; j > 0 && ev[j].tsc < ev[j-1].tsc; j--){
+      t = ev[j];
+      ev[j] = ev[j-1];
+      ev[j-1] = t;
+    }
+  done = 0;
+  for(i = 0; i < n; i++)
+    if(handle(&ev[i], pid))
+      done = 1;
+  return done;
+}
+
+void
+print(struct pstat *p)
+{
+  int b, h, lo, hi, n;
+
+  lo = NBUCKET;
+  hi = -1;
+  n = 0;
+  for(h = 0; h < 3; h++)
+    for(b = 0; b < NBUCKET; b++)
+      if(p->hist[h][b]){
+        if(b < lo)
+          lo = b;
+        if(b > hi)
+          hi = b;
+        if(h == RUN)
+          n += p->hist[h][b];
+      }
+  if(hi < 0)
+    return;
+  printf(1, "\npid %d: %d runs, %d priority changes\n", p->pid, n, p->prio);
+  printf(1, "usec\t\trun\twait\tsleep\n");
+  for(b = lo; b <= hi; b++){
+    if(b == 0)
+      printf(1, "<1\t\t");
+    else if(b == NBUCKET - 1)
+      printf(1, ">=%d\t", 1 << (b - 1));
+    else
+      printf(1, "%d-%d\t%s", 1 << (b - 1), (1 << b) - 1, b < 10 ? "\t" : "");
+    printf(1, "%d\t%d\t%d\n", p->hist[RUN][b], p->hist[WAIT][b],
+           p->hist[SLEEP][b]);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  struct pstat *p;
+  int pid, end;
+
+  calibrate();
+  if(schedtrace(ev, NEV) < 0){
+    printf(2, "schedlat: schedtrace failed\n");
+    exit();
+  }
+
+  pid = 0;
+  end = uptime() + DEFTICKS;
+  if(argc > 1){
+    pid = fork();
+    if(pid < 0){
+      printf(2, "schedlat: fork failed\n");
+      exit();
+    }
+    if(pid == 0){
+      exec(argv[1], argv + 1);
+      printf(2, "schedlat: exec %s failed\n", argv[1]);
+      exit();
+    }
+  }
+  for(;;){
+    sleep(DRAIN);
+    if(drain(pid) || (pid == 0 && uptime() >= end))
+      break;
+  }
+  if(pid)
+    wait();
+
+  printf(1, "%d cycles/usec", cyclesperus);
+  if(lost)
+    printf(1, ", %d events lost", lost);
+  printf(1, "\n");
+  for(p = pstat; p < &pstat[NPID]; p++)
+    print(p);
+  exit();
+}
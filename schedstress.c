@@ -1,6 +1,7 @@
 #ifdef CS333_P4
 #include "types.h"
 #include "user.h"
+#include "pdx.h"
 
 // Noah Zentzis, 2016
 
@@ -201,6 +202,88 @@ test4(void) {
   printf(1, "\n> test 4 complete\n");
 }
 
+// Test 5: MLFQ against CFS. Four CPU-bound processes at descending
+// priorities count loops for RUNTIME ticks while a probe process
+// sleeps one tick at a time and records how late it wakes up. Run
+// once under each policy and compare throughput, how the CPU was
+// shared, and the probe's tail latency.
+#define NHOG 4
+#define RUNTIME 3000
+#define NPROBE 200
+
+void
+hog(int fd, int id, int end) {
+  int rec[4] = { id, 0, 0, 0 };
+
+  for(;;) {
+    for(volatile int i = 0;i < 100000;i++);
+    rec[1]++;
+    if(uptime() >= end) break;
+  }
+  write(fd, rec, sizeof(rec));
+  exit();
+}
+
+void
+probe(int fd) {
+  int lat[NPROBE], rec[4], t, i, j, tmp;
+
+  for(i = 0;i < NPROBE;i++) {
+    t = uptime();
+    sleep(1);
+    lat[i] = uptime() - t - 1;
+  }
+  for(i = 1;i < NPROBE;i++)
+    for(j = i;j > 0 && lat[j-1] > lat[j];j--) {
+      tmp = lat[j]; lat[j] = lat[j-1]; lat[j-1] = tmp;
+    }
+  rec[0] = -1;
+  rec[1] = lat[NPROBE / 2];
+  rec[2] = lat[NPROBE * 99 / 100];
+  rec[3] = lat[NPROBE - 1];
+  write(fd, rec, sizeof(rec));
+  exit();
+}
+
+void
+test5(int policy) {
+  int fds[2], rec[4], counts[NHOG] = { 0 }, total, end, pid;
+
+  printf(1, "\n> starting test 5 (%s)\n", policy == SCHED_CFS ? "CFS" : "MLFQ");
+  if(setscheduler(policy) < 0) {
+    printf(2, "! setscheduler(%d) failed\n", policy);
+    return;
+  }
+  pipe(fds);
+  end = uptime() + RUNTIME;
+  for(int i = 0;i < NHOG;i++) {
+    if((pid = fork()) == 0)
+      hog(fds[1], i, end);
+    setpriority(pid, MAXPRIO - i < 0 ? 0 : MAXPRIO - i);
+  }
+  if(fork() == 0)
+    probe(fds[1]);
+  close(fds[1]);
+
+  total = 0;
+  while(read(fds[0], rec, sizeof(rec)) == sizeof(rec)) {
+    if(rec[0] < 0) {
+      printf(1, "probe wakeup latency: p50 %d p99 %d max %d ticks\n",
+             rec[1], rec[2], rec[3]);
+      continue;
+    }
+    counts[rec[0]] = rec[1];
+    total += rec[1];
+  }
+  close(fds[0]);
+  waitall();
+  printf(1, "throughput: %d loops\n", total);
+  for(int i = 0;i < NHOG;i++)
+    printf(1, "  priority %d: %d loops (%d%%)\n", MAXPRIO - i < 0 ? 0 : MAXPRIO - i,
+           counts[i], total ? counts[i] * 100 / total : 0);
+  printf(1, "\n> test 5 complete\n");
+}
+
 int
 main(int argc, char **argv) {
   int test = 0;
@@ -211,6 +294,12 @@ main(int argc, char **argv) {
   if(test == 2 || test == 0) test2();
   if(test == 3 || test == 0) test3();
   if(test == 4 || test == 0) test4();
+  if(test == 5 || test == 0) {
+    int old = setscheduler(SCHED_MLFQ);
+    test5(SCHED_MLFQ);
+    test5(SCHED_CFS);
+    setscheduler(old);
+  }
   exit();
 }
 #endif
@@ -0,0 +1,103 @@
+// Scheduler event tracing.
+//
+// Each CPU appends events to its own ring without taking a
+// lock: only that CPU writes the ring's head, and it does so
+// with interrupts off. schedtrace() drains the rings under a
+// lock of its own, so the scheduler never waits for a reader.
+// When a ring fills, its oldest events are overwritten and the
+// drain reports how many with an SE_LOST event.
+//
+// Timestamps come from each CPU's TSC, which are assumed to
+// run in step.
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "mmu.h"
+#include "proc.h"
+#include "spinlock.h"
+#include "x86.h"
+#include "schedtrace.h"
+
+struct tracering {
+  uint head;   // events ever recorded; written only by its CPU
+  uint tail;   // events drained; written only by schedtrace()
+  uint lost;   // events overwritten and not yet reported
+  struct schedevent ev[NSCHEDTRACE];
+};
+
+static struct tracering rings[NCPU];
+static struct spinlock tracelock;
+
+void
+schedtraceinit(void)
+{
+  initlock(&tracelock, "schedtrace");
+}
+
+// Record an event of type about p on this CPU.
+void
+schedlog(int type, struct proc *p, int arg)
+{
+  struct tracering *r;
+  struct schedevent *e;
+
+  pushcli();
+  r = &rings[cpuid()];
+  e = &r->ev[r->head % NSCHEDTRACE];
+  e->tsc = rdtsc();
+  e->pid = p->pid;
+  e->type = type;
+  e->cpu = cpuid();
+  e->arg = arg;
+  __sync_synchronize(); // the event before the head that covers it
+  r->head++;
+  popcli();
+}
+
+// Move up to max recorded events into ev, each CPU's in the
+// order they happened. Returns how many.
+int
+schedtrace(struct schedevent *ev, int max)
+{
+  struct tracering *r;
+  struct schedevent e;
+  uint head;
+  int n;
+
+  n = 0;
+  acquire(&tracelock);
+  for(r = rings; r < &rings[ncpu]; r++){
+    head = r->head;
+    __sync_synchronize();
+    while(r->tail != head && n < max){
+      if(head - r->tail > NSCHEDTRACE){
+        r->lost += head - NSCHEDTRACE - r->tail;
+        r->tail = head - NSCHEDTRACE;
+      }
+      e = r->ev[r->tail % NSCHEDTRACE];
+      __sync_synchronize();
+      if(r->head - r->tail >= NSCHEDTRACE){
+        // The CPU lapped us while we copied.
+        r->lost++;
+        r->tail++;
+        head = r->head;
+        continue;
+      }
+      if(r->lost){
+        if(n + 1 == max)
+          break;
+        ev[n] = e;
+        ev[n].pid = 0;
+        ev[n].type = SE_LOST;
+        ev[n].arg = r->lost > 0xffff ? 0xffff : r->lost;
+        r->lost = 0;
+        n++;
+      }
+      ev[n++] = e;
+      r->tail++;
+    }
+  }
+  release(&tracelock);
+  return n;
+}
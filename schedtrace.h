@@ -0,0 +1,22 @@
+// Scheduler events returned by the schedtrace() system call.
+
+#define NSCHEDTRACE 1024 // events each CPU keeps, a power of 2
+
+// Event types.
+#define SE_ENQUEUE  1  // new process made runnable
+#define SE_DISPATCH 2  // switched to; arg is the CPU
+#define SE_YIELD    3  // switched out, still runnable
+#define SE_SLEEP    4  // switched out to sleep
+#define SE_WAKEUP   5  // woken up (or killed) while asleep
+#define SE_PROMOTE  6  // MLFQ priority raised; arg is the new one
+#define SE_DEMOTE   7  // MLFQ priority lowered; arg is the new one
+#define SE_EXIT     8  // switched out for good
+#define SE_LOST     9  // arg events were overwritten before a drain
+
+struct schedevent {
+  uint64 tsc;    // rdtsc() when it happened
+  int pid;
+  uchar type;    // SE_*
+  uchar cpu;     // CPU that recorded it
+  ushort arg;
+};
@@ -0,0 +1,89 @@
+// Test per-uid fair sharing under the CFS scheduler: uid 1 runs
+// one CPU hog while uid 2 runs more and more of them, and uid 1's
+// part of the CPU should stay about the same throughout.
+#ifdef CS333_P4
+#include "types.h"
+#include "user.h"
+
+#define RUNTIME 2000 // ticks per round
+
+// Count loops as uid until end, then report on fd.
+void
+hog(int fd, int uid, int end)
+{
+  int rec[2];
+
+  setuid(uid);
+  rec[0] = uid;
+  rec[1] = 0;
+  while(uptime() < end){
+    for(volatile int i = 0; i < 100000; i++)
+      ;
+    rec[1]++;
+  }
+  write(fd, rec, sizeof(rec));
+  exit();
+}
+
+// Run one hog as uid 1 against n as uid 2. Returns uid 1's
+// percentage of the loops.
+int
+runround(int n)
+{
+  int fds[2], rec[2], loops[3], end, i;
+
+  if(pipe(fds) < 0){
+    printf(2, "sharetest: pipe failed\n");
+    exit();
+  }
+  loops[1] = loops[2] = 0;
+  end = uptime() + RUNTIME;
+  for(i = 0; i <= n; i++)
+    if(fork() == 0)
+      hog(fds[1], i == 0 ? 1 : 2, end);
+  close(fds[1]);
+  while(read(fds[0], rec, sizeof(rec)) == sizeof(rec))
+    loops[rec[0]] += rec[1];
+  close(fds[0]);
+  while(wait() != -1)
+    ;
+  if(loops[1] + loops[2] == 0)
+    return 0;
+  return loops[1] * 100 / (loops[1] + loops[2]);
+}
+
+int
+main(void)
+{
+  int n, first, share, old, ok;
+
+  if((old = setscheduler(SCHED_CFS)) < 0){
+    printf(2, "sharetest: setscheduler failed\n");
+    exit();
+  }
+  printf(1, "uid 2 hogs\tuid 1 share\n");
+  ok = 1;
+  first = runround(1);
+  printf(1, "1\t\t%d%%\n", first);
+  for(n = 4; n <= 16; n *= 2){
+    share = runround(n);
+    printf(1, "%d\t\t%d%%\n", n, share);
+    if(share < first / 2)
+      ok = 0;
+  }
+
+  if(setshare(2, 3 * DEFAULT_SHARE) < 0){
+    printf(2, "sharetest: setshare failed\n");
+    ok = 0;
+  } else {
+    share = runround(4);
+    printf(1, "4, uid 2 at 3x weight\t%d%%\n", share);
+    if(share >= first)
+      ok = 0;
+    setshare(2, DEFAULT_SHARE);
+  }
+  setscheduler(old);
+  printf(1, "sharetest: %s\n", ok ? "PASS" : "FAIL");
+  exit();
+}
+#endif
@@ -0,0 +1,219 @@
+// Slab allocator for kernel objects smaller than a page.
+//
+// Each cache carves pages from kalloc() into objects of one
+// size, such as struct proc or struct file. kmalloc() picks
+// one of a few size classes for objects that have no cache of
+// their own. Every CPU keeps up to SLABMAG free objects of each
+// cache, so most allocations take no lock; the rest move
+// SLABMAG/2 objects at a time to or from the cache's shared
+// free list. Pages are not given back to kalloc().
+
+#include "types.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "mmu.h"
+#include "spinlock.h"
+#include "slab.h"
+#include "slabinfo.h"
+
+struct run {
+  struct run *next;
+};
+
+static struct {
+  struct spinlock lock;
+  struct slabcache *cache[NSLAB];
+  int n;
+  // cache id + 1 for each physical page owned by a cache
+  uchar pagecache[PHYSTOP/PGSIZE];
+} slabs;
+
+// kmalloc() size classes.
+static uint kmsize[] = { 16, 32, 64, 128, 256, 512, 1024, 2048 };
+static char *kmname[] = { "kmalloc-16", "kmalloc-32", "kmalloc-64",
+  "kmalloc-128", "kmalloc-256", "kmalloc-512", "kmalloc-1024",
+  "kmalloc-2048" };
+static struct slabcache kmcache[NELEM(kmsize)];
+
+void
+slabinit(struct slabcache *c, char *name, uint size)
+{
+  if(size > PGSIZE)
+    panic("slabinit: object too big");
+  initlock(&c->lock, name);
+  c->name = name;
+  if(size < sizeof(struct run))
+    size = sizeof(struct run);
+  c->size = (size + sizeof(uint) - 1) & ~(sizeof(uint) - 1);
+  c->free = 0;
+  c->npages = 0;
+  memset(c->cpu, 0, sizeof(c->cpu));
+
+  acquire(&slabs.lock);
+  if(slabs.n == NSLAB)
+    panic("slabinit: too many caches");
+  c->id = slabs.n;
+  slabs.cache[slabs.n++] = c;
+  release(&slabs.lock);
+}
+
+void
+kmallocinit(void)
+{
+  int i;
+
+  initlock(&slabs.lock, "slabs");
+  for(i = 0; i < NELEM(kmsize); i++)
+    slabinit(&kmcache[i], kmname[i], kmsize[i]);
+}
+
+// Cut a new page into free objects.
+// Caller holds c->lock.
+static int
+slabgrow(struct slabcache *c)
+{
+  char *page, *o;
+  struct run *r;
+
+  if((page = kalloc()) == 0)
+    return -1;
+  slabs.pagecache[V2P(page)/PGSIZE] = c->id + 1;
+  for(o = page; o + c->size <= page + PGSIZE; o += c->size){
+    r = (struct run*)o;
+    r->next = c->free;
+    c->free = r;
+  }
+  c->npages++;
+  return 0;
+}
+
+// Move up to SLABMAG/2 objects from c's free list to cc.
+static void
+slabrefill(struct slabcache *c, struct slabcpu *cc)
+{
+  struct run *r;
+
+  acquire(&c->lock);
+  if(c->free == 0)
+    slabgrow(c);
+  while(cc->nfree < SLABMAG/2 && (r = c->free) != 0){
+    c->free = r->next;
+    r->next = cc->free;
+    cc->free = r;
+    cc->nfree++;
+  }
+  release(&c->lock);
+}
+
+// Move SLABMAG/2 objects from cc back to c's free list.
+static void
+slabdrain(struct slabcache *c, struct slabcpu *cc)
+{
+  struct run *r;
+
+  acquire(&c->lock);
+  while(cc->nfree > SLABMAG/2){
+    r = cc->free;
+    cc->free = r->next;
+    cc->nfree--;
+    r->next = c->free;
+    c->free = r;
+  }
+  release(&c->lock);
+}
+
+// Allocate a zeroed object from c.
+// Returns 0 if the memory cannot be allocated.
+void*
+slaballoc(struct slabcache *c)
+{
+  struct slabcpu *cc;
+  struct run *r;
+
+  pushcli();
+  cc = &c->cpu[cpuid()];
+  if(cc->free == 0)
+    slabrefill(c, cc);
+  if((r = cc->free) != 0){
+    cc->free = r->next;
+    cc->nfree--;
+    cc->nalloc++;
+  }
+  popcli();
+  if(r)
+    memset(r, 0, c->size);
+  return r;
+}
+
+// Return an object that slaballoc(c) handed out.
+void
+slabfree(struct slabcache *c, void *v)
+{
+  struct slabcpu *cc;
+  struct run *r = v;
+
+  pushcli();
+  cc = &c->cpu[cpuid()];
+  r->next = cc->free;
+  cc->free = r;
+  cc->nfree++;
+  cc->nrelease++;
+  if(cc->nfree > SLABMAG)
+    slabdrain(c, cc);
+  popcli();
+}
+
+// Allocate n zeroed bytes. Requests larger than the biggest
+// size class get a whole page. Returns 0 if n is bigger than
+// a page or the memory cannot be allocated.
+void*
+kmalloc(uint n)
+{
+  char *p;
+  int i;
+
+  for(i = 0; i < NELEM(kmsize); i++)
+    if(n <= kmsize[i])
+      return slaballoc(&kmcache[i]);
+  if(n > PGSIZE || (p = kalloc()) == 0)
+    return 0;
+  memset(p, 0, PGSIZE);
+  return p;
+}
+
+// Free memory from kmalloc(), or an object from any cache.
+void
+kmfree(void *v)
+{
+  int id;
+
+  if((id = slabs.pagecache[V2P(v)/PGSIZE]) == 0){
+    kfree(v);
+    return;
+  }
+  slabfree(slabs.cache[id-1], v);
+}
+
+// Copy statistics for up to max caches to info.
+// Returns the number of caches copied.
+int
+slabinfo(struct slabinfo *info, int max)
+{
+  struct slabcache *c;
+  int i, j;
+
+  acquire(&slabs.lock);
+  for(i = 0; i < slabs.n && i < max; i++){
+    c = slabs.cache[i];
+    safestrcpy(info[i].name, c->name, sizeof(info[i].name));
+    info[i].size = c->size;
+    info[i].inuse = 0;
+    for(j = 0; j < NCPU; j++)
+      info[i].inuse += c->cpu[j].nalloc - c->cpu[j].nrelease;
+    info[i].total = c->npages * (PGSIZE / c->size);
+    info[i].pages = c->npages;
+  }
+  release(&slabs.lock);
+  return i;
+}
@@ -0,0 +1,23 @@
+// A cache of equal-sized kernel objects; see slab.c.
+// Needs param.h and spinlock.h.
+
+#define SLABMAG 16  // free objects a CPU may keep for itself
+
+// Objects a CPU took from or gave back to a cache
+// without taking the cache's lock.
+struct slabcpu {
+  struct run *free;   // this CPU's free objects
+  int nfree;          // length of free
+  uint nalloc;        // slaballoc()s on this CPU
+  uint nrelease;      // slabfree()s on this CPU
+};
+
+struct slabcache {
+  struct spinlock lock;
+  char *name;
+  int id;             // index in slab.c's table of caches
+  uint size;          // object size, rounded up to a word
+  struct run *free;   // free objects not held by any CPU
+  uint npages;        // pages taken from kalloc()
+  struct slabcpu cpu[NCPU];
+};
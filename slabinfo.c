@@ -0,0 +1,27 @@
+// Print how much of each kernel slab cache is in use.
+
+#include "types.h"
+#include "user.h"
+#include "slabinfo.h"
+
+struct slabinfo info[NSLAB];
+
+int
+main(int argc, char *argv[])
+{
+  int i, n;
+
+  if((n = slabinfo(info, NSLAB)) < 0){
+    printf(2, "slabinfo: slabinfo failed\n");
+    exit();
+  }
+  printf(1, "name\t\tsize\tinuse\ttotal\tpages\n");
+  for(i = 0; i < n; i++){
+    printf(1, "%s\t", info[i].name);
+    if(strlen(info[i].name) < 8)
+      printf(1, "\t");
+    printf(1, "%d\t%d\t%d\t%d\n", info[i].size, info[i].inuse,
+           info[i].total, info[i].pages);
+  }
+  exit();
+}
@@ -0,0 +1,11 @@
+// Slab cache statistics returned by the slabinfo() system call.
+
+#define NSLAB 32  // maximum number of slab caches
+
+struct slabinfo {
+  char name[16];
+  uint size;    // object size in bytes
+  uint inuse;   // objects allocated
+  uint total;   // objects that fit in the cache's pages
+  uint pages;   // pages taken from kalloc()
+};
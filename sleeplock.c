@@ -16,31 +16,93 @@ initsleeplock(struct sleeplock *lk, char *name)
   initlock(&lk->lk, "sleep lock");
   lk->name = name;
   lk->locked = 0;
+  lk->readers = 0;
+  lk->wwait = 0;
   lk->pid = 0;
+#ifdef CS333_P4
+  lk->waitprio = -1;
+  lk->nextheld = 0;
+#endif
 }
 
 void
 acquiresleep(struct sleeplock *lk)
 {
+#ifdef CS333_P4
+  struct proc *p = myproc();
+#endif
+
   acquire(&lk->lk);
-  while (lk->locked) {
+  lk->wwait++;
+  while (lk->locked || lk->readers) {
+#ifdef CS333_P4
+    // Lend our priority to the holder while we wait.
+    if (lk->locked)
+      sleeplockwait(lk);
+#endif
     sleep(lk, &lk->lk);
   }
+  lk->wwait--;
   lk->locked = 1;
   lk->pid = myproc()->pid;
+#ifdef CS333_P4
+  p->blockedon = 0;
+  lk->nextheld = p->held;
+  p->held = lk;
+#endif
   release(&lk->lk);
 }
 
 void
 releasesleep(struct sleeplock *lk)
 {
+#ifdef CS333_P4
+  struct sleeplock **pp;
+#endif
+
   acquire(&lk->lk);
   lk->locked = 0;
   lk->pid = 0;
+#ifdef CS333_P4
+  for (pp = &myproc()->held; *pp; pp = &(*pp)->nextheld) {
+    if (*pp == lk) {
+      *pp = lk->nextheld;
+      break;
+    }
+  }
+  // The waiters all wake up and set waitprio again if they
+  // have to go back to sleep.
+  lk->waitprio = -1;
+  sleeplockunboost();
+#endif
   wakeup(lk);
   release(&lk->lk);
 }
 
+// Acquire lk shared with other readers. Waits while the lock is
+// held exclusively or someone is waiting to take it exclusively.
+void
+acquiresleepshared(struct sleeplock *lk)
+{
+  acquire(&lk->lk);
+  while (lk->locked || lk->wwait) {
+    sleep(lk, &lk->lk);
+  }
+  lk->readers++;
+  release(&lk->lk);
+}
+
+void
+releasesleepshared(struct sleeplock *lk)
+{
+  acquire(&lk->lk);
+  if (lk->readers < 1)
+    panic("releasesleepshared");
+  if (--lk->readers == 0)
+    wakeup(lk);
+  release(&lk->lk);
+}
+
 int
 holdingsleep(struct sleeplock *lk)
 {
@@ -1,10 +1,20 @@
 // Long-term locks for processes
+// Held either exclusively (acquiresleep) or shared by any
+// number of readers (acquiresleepshared).
 struct sleeplock {
-  uint locked;       // Is the lock held?
+  uint locked;       // Is the lock held exclusively?
   struct spinlock lk; // spinlock protecting this sleep lock
-  
+  int readers;       // Number of shared holders
+  int wwait;         // Exclusive acquirers waiting; keeps readers out
+
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+
+#ifdef CS333_P4
+  // Priority inheritance; see sleeplockwait().
+  int waitprio;      // Highest priority of a waiter, or -1
+  struct sleeplock *nextheld; // Next lock in the holder's p->held
+#endif
 };
 
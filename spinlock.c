@@ -8,13 +8,26 @@
 #include "mmu.h"
 #include "proc.h"
 #include "spinlock.h"
+#include "lockstat.h"
+
+extern char end[]; // first address after kernel loaded from ELF file
+
+// Locks in the kernel's own data, for lockstat(). Locks inside
+// kmalloc()ed objects come and go, so they are not listed.
+static struct spinlock *locks;
 
 void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
-  lk->locked = 0;
+  lk->next = 0;
+  lk->owner = 0;
   lk->cpu = 0;
+  if((char*)lk < end){
+    do
+      lk->nextlock = locks;
+    while(!__sync_bool_compare_and_swap(&locks, lk->nextlock, lk));
+  }
 }
 
 // Acquire the lock.
@@ -24,13 +37,21 @@ initlock(struct spinlock *lk, char *name)
 void
 acquire(struct spinlock *lk)
 {
+  uint ticket;
+  uint64 t0;
+
   pushcli(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
-  // The xchg is atomic.
-  while(xchg(&lk->locked, 1) != 0)
-    ;
+  // The lock prefix makes the fetch-and-add atomic.
+  ticket = __sync_fetch_and_add(&lk->next, 1);
+  t0 = 0;
+  if(ticket != *(volatile uint*)&lk->owner){
+    t0 = rdtsc();
+    while(ticket != *(volatile uint*)&lk->owner)
+      pause();
+  }
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,15 +61,29 @@ acquire(struct spinlock *lk)
   // Record info about lock acquisition for debugging.
   lk->cpu = mycpu();
   getcallerpcs(&lk, lk->pcs);
+
+  lk->tacquire = rdtsc();
+  lk->nacquire++;
+  if(t0){
+    lk->ncontend++;
+    lk->spin += lk->tacquire - t0;
+  }
 }
 
 // Release the lock.
 void
 release(struct spinlock *lk)
 {
+  uint held;
+
   if(!holding(lk))
     panic("release");
 
+  held = rdtsc() - lk->tacquire;
+  lk->hold += held;
+  if(held > lk->maxhold)
+    lk->maxhold = held;
+
   lk->pcs[0] = 0;
   lk->cpu = 0;
 
@@ -59,10 +94,10 @@ release(struct spinlock *lk)
   // stores; __sync_synchronize() tells them both not to.
   __sync_synchronize();
 
-  // Release the lock, equivalent to lk->locked = 0.
-  // This code can't use a C assignment, since it might
-  // not be atomic. A real OS would use C atomics here.
-  asm volatile("movl $0, %0" : "+m" (lk->locked) : );
+  // Release the lock by serving the next ticket. Only the holder
+  // writes owner, so a plain increment will do, but it must not
+  // be split or reordered by the compiler.
+  asm volatile("incl %0" : "+m" (lk->owner) : );
 
   popcli();
 }
@@ -91,7 +126,7 @@ holding(struct spinlock *lock)
 {
   int r;
   pushcli();
-  r = lock->locked && lock->cpu == mycpu();
+  r = lock->owner != lock->next && lock->cpu == mycpu();
   popcli();
   return r;
 }
@@ -124,3 +159,24 @@ popcli(void)
     sti();
 }
 
+
+// Copy statistics for up to max locks in the kernel's data to ls.
+// Returns the number of locks copied. The counters are read
+// without the locks, so a busy lock's numbers may be slightly off.
+int
+lockstat(struct lockstat *ls, int max)
+{
+  struct spinlock *lk;
+  int n;
+
+  n = 0;
+  for(lk = locks; lk && n < max; lk = lk->nextlock, n++){
+    safestrcpy(ls[n].name, lk->name, sizeof(ls[n].name));
+    ls[n].nacquire = lk->nacquire;
+    ls[n].ncontend = lk->ncontend;
+    ls[n].spin = lk->spin >> 10;
+    ls[n].hold = lk->hold >> 10;
+    ls[n].maxhold = lk->maxhold;
+  }
+  return n;
+}
@@ -1,11 +1,23 @@
 // Mutual exclusion lock.
+// A ticket lock: acquire() takes the next ticket and waits
+// until owner reaches it, so CPUs get the lock in FIFO order
+// and spin reading owner rather than writing the lock word.
 struct spinlock {
-  uint locked;       // Is the lock held?
+  uint next;         // Next ticket to hand out.
+  uint owner;        // Ticket now holding (or allowed to take) the lock.
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
   uint pcs[10];      // The call stack (an array of program counters)
                      // that locked the lock.
-};
 
+  // Statistics, updated by the holder; see lockstat.h.
+  uint nacquire;     // Times acquired.
+  uint ncontend;     // Times acquire() had to wait.
+  uint64 spin;       // Cycles spent waiting in acquire().
+  uint64 hold;       // Cycles held in all.
+  uint maxhold;      // Longest hold, in cycles.
+  uint64 tacquire;   // rdtsc() when last acquired.
+  struct spinlock *nextlock; // Next lock in the kernel's data; see initlock().
+};
@@ -0,0 +1,172 @@
+// Compare ulib's string routines with the byte loops they
+// replaced, on the contents of some files.
+
+#include "types.h"
+#include "stat.h"
+#include "user.h"
+#include "fcntl.h"
+#include "x86.h"
+
+#define MAXBUF (64*1024)
+#define REPS 8
+
+char buf[MAXBUF+1], copy[MAXBUF+1];
+char *defaults[] = { "README", "cat", "grep", "usertests" };
+
+// The old ulib.c versions.
+
+static uint
+oldstrlen(char *s)
+{
+  int n;
+
+  for(n = 0; s[n]; n++)
+    ;
+  return n;
+}
+
+static int
+oldstrcmp(const char *p, const char *q)
+{
+  while(*p && *p == *q)
+    p++, q++;
+  return (uchar)*p - (uchar)*q;
+}
+
+static char*
+oldstrchr(const char *s, char c)
+{
+  for(; *s; s++)
+    if(*s == c)
+      return (char*)s;
+  return 0;
+}
+
+static void*
+oldmemset(void *dst, int c, uint n)
+{
+  stosb(dst, c, n);
+  return dst;
+}
+
+static void*
+oldmemmove(void *vdst, void *vsrc, int n)
+{
+  char *dst, *src;
+
+  dst = vdst;
+  src = vsrc;
+  while(n-- > 0)
+    *dst++ = *src++;
+  return vdst;
+}
+
+volatile int sink;
+
+// Average cycles for one pass of string routine which (old or
+// new) over the strings in buf[0..n).
+static uint
+strtime(int n, int which, int old)
+{
+  uint64 t;
+  char *s;
+  int i;
+
+  t = rdtsc();
+  for(i = 0; i < REPS; i++){
+    for(s = buf; s < buf + n; s += oldstrlen(s) + 1){
+      switch(which){
+      case 0:
+        sink = old ? oldstrlen(s) : strlen(s);
+        break;
+      case 1:
+        sink = old ? oldstrcmp(s, copy + (s - buf)) : strcmp(s, copy + (s - buf));
+        break;
+      case 2:
+        sink = old ? oldstrchr(s, '~') != 0 : strchr(s, '~') != 0;
+        break;
+      }
+    }
+  }
+  return (uint)(rdtsc() - t) / REPS;
+}
+
+// Likewise for memset (which 0) or memmove (which 1) of n bytes.
+static uint
+memtime(int n, int which, int old)
+{
+  uint64 t;
+  int i;
+
+  t = rdtsc();
+  for(i = 0; i < REPS; i++){
+    if(which == 0 && old)
+      oldmemset(copy, 0, n);
+    else if(which == 0)
+      memset(copy, 0, n);
+    else if(old)
+      oldmemmove(copy, buf, n);
+    else
+      memmove(copy, buf, n);
+  }
+  return (uint)(rdtsc() - t) / REPS;
+}
+
+// Print n/cycles with two decimals.
+static void
+rate(uint n, uint cycles)
+{
+  uint r;
+
+  r = cycles ? n * 100 / cycles : 0;
+  printf(1, "\t%d.%d%d", r / 100, r / 10 % 10, r % 10);
+}
+
+static void
+bench(char *file)
+{
+  static char *names[] = { "strlen", "strcmp", "strchr" };
+  int fd, n, i;
+
+  if((fd = open(file, O_RDONLY)) < 0){
+    printf(2, "strbench: cannot open %s\n", file);
+    return;
+  }
+  n = read(fd, buf, MAXBUF);
+  close(fd);
+  if(n <= 0)
+    return;
+  buf[n] = 0;
+  for(i = 0; i < n; i++)
+    if(buf[i] == '\n')
+      buf[i] = 0;
+
+  for(i = 0; i < 3; i++){
+    memmove(copy, buf, n + 1);
+    printf(1, "%s\t%s", file, names[i]);
+    rate(n, strtime(n, i, 1));
+    rate(n, strtime(n, i, 0));
+    printf(1, "\n");
+  }
+  printf(1, "%s\tmemset", file);
+  rate(n, memtime(n, 0, 1));
+  rate(n, memtime(n, 0, 0));
+  printf(1, "\n%s\tmemmove", file);
+  rate(n, memtime(n, 1, 1));
+  rate(n, memtime(n, 1, 0));
+  printf(1, "\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int i;
+
+  printf(1, "bytes/cycle\t\told\tnew\n");
+  if(argc < 2)
+    for(i = 0; i < sizeof(defaults)/sizeof(defaults[0]); i++)
+      bench(defaults[i]);
+  for(i = 1; i < argc; i++)
+    bench(argv[i]);
+  exit();
+}
@@ -1,5 +1,8 @@
 #include "types.h"
+#include "defs.h"
 #include "x86.h"
+#include "mmu.h"
+#include "membench.h"
 
 void*
 memset(void *dst, int c, uint n)
@@ -12,13 +15,31 @@ memset(void *dst, int c, uint n)
   return dst;
 }
 
-int
-memcmp(const void *v1, const void *v2, uint n)
+// Does the CPU have SSE2? Set once at boot by stringinit().
+// If so, memmove() uses it for copies of at least SSEMIN bytes
+// and processes get their own x87/SSE registers.
+int sse2;
+
+#define SSEMIN 256
+
+// Enable SSE on this CPU and, if it has SSE2, use it for large
+// copies. Every CPU calls this before it runs other kernel code.
+void
+stringinit(void)
 {
-  const uchar *s1, *s2;
+  uint edx;
 
-  s1 = v1;
-  s2 = v2;
+  cpuinfo(1, 0, 0, 0, &edx);
+  if(!(edx & CPUID_SSE2))
+    return;
+  lcr0((rcr0() & ~CR0_EM) | CR0_MP);
+  lcr4(rcr4() | CR4_OSFXSR);
+  sse2 = 1;
+}
+
+static int
+bytecmp(const uchar *s1, const uchar *s2, uint n)
+{
   while(n-- > 0){
     if(*s1 != *s2)
       return *s1 - *s2;
@@ -28,14 +49,25 @@ memcmp(const void *v1, const void *v2, uint n)
   return 0;
 }
 
-void*
-memmove(void *dst, const void *src, uint n)
+// Compare a word at a time, then find the differing byte.
+static int
+wordcmp(const uchar *s1, const uchar *s2, uint n)
 {
-  const char *s;
-  char *d;
+  for(; n >= 4; n -= 4, s1 += 4, s2 += 4)
+    if(*(uint*)s1 != *(uint*)s2)
+      break;
+  return bytecmp(s1, s2, n);
+}
 
-  s = src;
-  d = dst;
+int
+memcmp(const void *v1, const void *v2, uint n)
+{
+  return wordcmp(v1, v2, n);
+}
+
+static void
+bytemove(char *d, const char *s, uint n)
+{
   if(s < d && s + n > d){
     s += n;
     d += n;
@@ -44,6 +76,90 @@ memmove(void *dst, const void *src, uint n)
   } else
     while(n-- > 0)
       *d++ = *s++;
+}
+
+static void
+movsl(void *d, const void *s, uint n)
+{
+  asm volatile("cld; rep movsl" :
+               "+D" (d), "+S" (s), "+c" (n) : : "memory", "cc");
+}
+
+static void
+movsb(void *d, const void *s, uint n)
+{
+  asm volatile("cld; rep movsb" :
+               "+D" (d), "+S" (s), "+c" (n) : : "memory", "cc");
+}
+
+// Copy with rep movsl, backwards if dst overlaps the end of src.
+static void
+wordmove(char *d, const char *s, uint n)
+{
+  if(s < d && s + n > d){
+    if(((uint)d|(uint)s|n) % 4 != 0){
+      bytemove(d, s, n);
+      return;
+    }
+    d += n - 4;
+    s += n - 4;
+    n /= 4;
+    asm volatile("std; rep movsl; cld" :
+                 "+D" (d), "+S" (s), "+c" (n) : : "memory", "cc");
+    return;
+  }
+  movsl(d, s, n/4);
+  movsb(d + (n & ~3), s + (n & ~3), n % 4);
+}
+
+// Copy 64 bytes at a time through the XMM registers once dst
+// is 16-byte aligned. Only for copies that do not overlap.
+// The registers hold the current process's user values, so
+// save them, and keep interrupts off until they are restored.
+static void
+ssemove(char *d, const char *s, uint n)
+{
+  char xmm[64];
+  uint head;
+
+  head = (16 - (uint)d % 16) % 16;
+  movsb(d, s, head);
+  d += head, s += head, n -= head;
+  pushcli();
+  asm volatile("movdqu %%xmm0, 0(%0)\n\t"
+               "movdqu %%xmm1, 16(%0)\n\t"
+               "movdqu %%xmm2, 32(%0)\n\t"
+               "movdqu %%xmm3, 48(%0)" : : "r" (xmm) : "memory");
+  for(; n >= 64; n -= 64, d += 64, s += 64)
+    asm volatile("movdqu 0(%1), %%xmm0\n\t"
+                 "movdqu 16(%1), %%xmm1\n\t"
+                 "movdqu 32(%1), %%xmm2\n\t"
+                 "movdqu 48(%1), %%xmm3\n\t"
+                 "movdqa %%xmm0, 0(%0)\n\t"
+                 "movdqa %%xmm1, 16(%0)\n\t"
+                 "movdqa %%xmm2, 32(%0)\n\t"
+                 "movdqa %%xmm3, 48(%0)" :
+                 : "r" (d), "r" (s) : "memory");
+  asm volatile("movdqu 0(%0), %%xmm0\n\t"
+               "movdqu 16(%0), %%xmm1\n\t"
+               "movdqu 32(%0), %%xmm2\n\t"
+               "movdqu 48(%0), %%xmm3" : : "r" (xmm) : "memory");
+  popcli();
+  wordmove(d, s, n);
+}
+
+void*
+memmove(void *dst, const void *src, uint n)
+{
+  const char *s;
+  char *d;
+
+  s = src;
+  d = dst;
+  if(sse2 && n >= SSEMIN && (d + n <= s || s + n <= d))
+    ssemove(d, s, n);
+  else
+    wordmove(d, s, n);
 
   return dst;
 }
@@ -103,3 +219,48 @@ strlen(const char *s)
   return n;
 }
 
+
+// Keeps membench()'s compares from being optimized away.
+volatile int membenchsink;
+
+// Time cycles per call of each memmove() and memcmp() in this
+// file for the sizes in mb->size. Returns -1 if no memory.
+int
+membench(struct membench *mb)
+{
+  static uint sizes[NMEMBENCH] = { 64, 512, 2048, 4096 };
+  char *a, *b;
+  uint64 t;
+  int i, j;
+
+// Run x once to warm the cache, then average REPS more runs.
+#define REPS 64
+#define TIME(x) \
+  ({ x; t = rdtsc(); for(j = 0; j < REPS; j++) x; (uint)(rdtsc() - t) / REPS; })
+
+  if((a = kalloc()) == 0)
+    return -1;
+  if((b = kalloc()) == 0){
+    kfree(a);
+    return -1;
+  }
+  memset(a, 1, PGSIZE);
+  memset(b, 1, PGSIZE);
+  pushcli();
+  for(i = 0; i < NMEMBENCH; i++){
+    mb->size[i] = sizes[i];
+    mb->bytemove[i] = TIME(bytemove(b, a, sizes[i]));
+    mb->wordmove[i] = TIME(wordmove(b, a, sizes[i]));
+    mb->ssemove[i] = sse2 ? TIME(ssemove(b, a, sizes[i])) : 0;
+    mb->bytecmp[i] = TIME(membenchsink = bytecmp((uchar*)a, (uchar*)b, sizes[i]));
+    mb->wordcmp[i] = TIME(membenchsink = wordcmp((uchar*)a, (uchar*)b, sizes[i]));
+  }
+  popcli();
+
+#undef REPS
+#undef TIME
+
+  kfree(a);
+  kfree(b);
+  return 0;
+}
@@ -0,0 +1,50 @@
+// Measure how many getpid() system calls per second user code
+// makes through usys.S, which uses sysenter when the CPU has it,
+// and through int $T_SYSCALL, and how fast the vdso.h pages
+// answer the same questions.
+
+#include "types.h"
+#include "user.h"
+#include "syscall.h"
+#include "traps.h"
+
+#define CHUNK 10000
+#define MINTIME 1000  // ticks to run each loop
+
+static int
+intgetpid(void)
+{
+  int pid;
+
+  asm volatile("int %1" : "=a" (pid) : "i" (T_SYSCALL), "0" (SYS_getpid) :
+               "memory");
+  return pid;
+}
+
+static void
+run(char *name, int (*f)(void))
+{
+  uint n, t, t0;
+  int i;
+
+  n = 0;
+  t0 = uptime();
+  do {
+    for(i = 0; i < CHUNK; i++)
+      f();
+    n += CHUNK;
+    t = uptime() - t0;
+  } while(t < MINTIME);
+  printf(1, "%s\t%d calls/sec\n", name, n / t * 1000 + n % t * 1000 / t);
+}
+
+int
+main(int argc, char *argv[])
+{
+  run("getpid()", getpid);
+  run("int $64", intgetpid);
+  run("vgetpid()", vgetpid);
+  run("uptime()", uptime);
+  run("vuptime()", vuptime);
+  exit();
+}
@@ -99,6 +99,21 @@ extern int sys_unlink(void);
 extern int sys_wait(void);
 extern int sys_write(void);
 extern int sys_uptime(void);
+extern int sys_readv(void);
+extern int sys_writev(void);
+extern int sys_pread(void);
+extern int sys_pwrite(void);
+extern int sys_logstat(void);
+extern int sys_slabinfo(void);
+extern int sys_membench(void);
+extern int sys_lockstat(void);
+extern int sys_clone(void);
+extern int sys_join(void);
+extern int sys_futex_wait(void);
+extern int sys_futex_wake(void);
+extern int sys_sched_setaffinity(void);
+extern int sys_sched_getaffinity(void);
+extern int sys_schedtrace(void);
 #ifdef PDX_XV6
 extern int sys_halt(void);
 #endif // PDX_XV6
@@ -112,10 +127,15 @@ extern int sys_getppid(void);
 extern int sys_setuid(void);
 extern int sys_setgid(void);
 extern int sys_getprocs(void);
+extern int sys_cputime(void);
 #endif // for P2
 #ifdef CS333_P4
 extern int sys_setpriority(void);
 extern int sys_getpriority(void);
+extern int sys_setscheduler(void);
+extern int sys_setshare(void);
+extern int sys_setdeadline(void);
+extern int sys_rtwait(void);
 #endif
 
 static int (*syscalls[])(void) = {
@@ -140,6 +160,21 @@ static int (*syscalls[])(void) = {
     [SYS_link] sys_link,
     [SYS_mkdir] sys_mkdir,
     [SYS_close] sys_close,
+    [SYS_readv] sys_readv,
+    [SYS_writev] sys_writev,
+    [SYS_pread] sys_pread,
+    [SYS_pwrite] sys_pwrite,
+    [SYS_logstat] sys_logstat,
+    [SYS_slabinfo] sys_slabinfo,
+    [SYS_membench] sys_membench,
+    [SYS_lockstat] sys_lockstat,
+    [SYS_clone] sys_clone,
+    [SYS_join] sys_join,
+    [SYS_futex_wait] sys_futex_wait,
+    [SYS_futex_wake] sys_futex_wake,
+    [SYS_sched_setaffinity] sys_sched_setaffinity,
+    [SYS_sched_getaffinity] sys_sched_getaffinity,
+    [SYS_schedtrace] sys_schedtrace,
 #ifdef PDX_XV6
     [SYS_halt] sys_halt,
 #endif // PDX_XV6
@@ -153,10 +188,15 @@ static int (*syscalls[])(void) = {
     [SYS_setuid] sys_setuid,
     [SYS_setgid] sys_setgid,
     [SYS_getprocs] sys_getprocs,
+    [SYS_cputime] sys_cputime,
 #endif // P2
 #ifdef CS333_P4
     [SYS_setpriority] sys_setpriority,
     [SYS_getpriority] sys_getpriority,
+    [SYS_setscheduler] sys_setscheduler,
+    [SYS_setshare] sys_setshare,
+    [SYS_setdeadline] sys_setdeadline,
+    [SYS_rtwait] sys_rtwait,
 #endif
 
 };
@@ -184,6 +224,21 @@ static char *syscallnames[] = {
     [SYS_link] "link",
     [SYS_mkdir] "mkdir",
     [SYS_close] "close",
+    [SYS_readv] "readv",
+    [SYS_writev] "writev",
+    [SYS_pread] "pread",
+    [SYS_pwrite] "pwrite",
+    [SYS_logstat] "logstat",
+    [SYS_slabinfo] "slabinfo",
+    [SYS_membench] "membench",
+    [SYS_lockstat] "lockstat",
+    [SYS_clone] "clone",
+    [SYS_join] "join",
+    [SYS_futex_wait] "futex_wait",
+    [SYS_futex_wake] "futex_wake",
+    [SYS_sched_setaffinity] "sched_setaffinity",
+    [SYS_sched_getaffinity] "sched_getaffinity",
+    [SYS_schedtrace] "schedtrace",
 #ifdef PDX_XV6
     [SYS_halt] "halt",
 #endif // PDX_XV6
@@ -197,6 +252,7 @@ static char *syscallnames[] = {
     [SYS_setuid] "setuid",
     [SYS_setgid] "setgid",
     [SYS_getprocs] "getprocs",
+    [SYS_cputime] "cputime",
 #endif // P2
 };
 #endif // PRINT_SYSCALLS
@@ -209,7 +265,15 @@ void syscall(void)
   num = curproc->tf->eax;
   if (num > 0 && num < NELEM(syscalls) && syscalls[num])
   {
+    uvmenter();
     curproc->tf->eax = syscalls[num]();
+    uvmleave();
+    if (curproc->fheld)
+    {
+      // See argfd().
+      fileclose(curproc->fheld);
+      curproc->fheld = 0;
+    }
 #ifdef PRINT_SYSCALLS
     cprintf("%s->%d\n", syscallnames[num], curproc->tf->eax); //P1
 #endif
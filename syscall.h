@@ -30,4 +30,24 @@
 #define SYS_getprocs SYS_setgid + 1
 #define SYS_setpriority SYS_getprocs + 1
 #define SYS_getpriority SYS_setpriority + 1
+#define SYS_readv SYS_getpriority + 1
+#define SYS_writev SYS_readv + 1
+#define SYS_pread SYS_writev + 1
+#define SYS_pwrite SYS_pread + 1
+#define SYS_logstat SYS_pwrite + 1
+#define SYS_slabinfo SYS_logstat + 1
+#define SYS_membench SYS_slabinfo + 1
+#define SYS_lockstat SYS_membench + 1
+#define SYS_clone SYS_lockstat + 1
+#define SYS_join SYS_clone + 1
+#define SYS_futex_wait SYS_join + 1
+#define SYS_futex_wake SYS_futex_wait + 1
+#define SYS_setscheduler SYS_futex_wake + 1
+#define SYS_setshare SYS_setscheduler + 1
+#define SYS_sched_setaffinity SYS_setshare + 1
+#define SYS_sched_getaffinity SYS_sched_setaffinity + 1
+#define SYS_setdeadline SYS_sched_getaffinity + 1
+#define SYS_rtwait SYS_setdeadline + 1
+#define SYS_cputime SYS_rtwait + 1
+#define SYS_schedtrace SYS_cputime + 1
 // student system calls begin here. Follow the existing pattern.
\ No newline at end of file
@@ -15,18 +15,36 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "uio.h"
+#include "logstat.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
+// If other threads share the descriptor table, one of them could
+// close f while this system call uses it, so hold a reference
+// until syscall() returns.
 static int
 argfd(int n, int *pfd, struct file **pf)
 {
   int fd;
   struct file *f;
+  struct proc *curproc = myproc();
 
   if(argint(n, &fd) < 0)
     return -1;
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if(fd < 0 || fd >= NOFILE)
+    return -1;
+  // Only a thread can make another, so nthreads is stable at 0.
+  if(curproc->thread || curproc->nthreads){
+    if(pf == 0)
+      f = procfiles(curproc)[fd];
+    else if(curproc->fheld == 0)
+      f = curproc->fheld = fileget(&procfiles(curproc)[fd]);
+    else
+      panic("argfd");
+  } else
+    f = curproc->ofile[fd];
+  if(f == 0)
     return -1;
   if(pfd)
     *pfd = fd;
@@ -41,13 +59,11 @@ static int
 fdalloc(struct file *f)
 {
   int fd;
-  struct proc *curproc = myproc();
+  struct file **ofile = procfiles(myproc());
 
   for(fd = 0; fd < NOFILE; fd++){
-    if(curproc->ofile[fd] == 0){
-      curproc->ofile[fd] = f;
+    if(ofile[fd] == 0 && __sync_bool_compare_and_swap(&ofile[fd], 0, f))
       return fd;
-    }
   }
   return -1;
 }
@@ -90,15 +106,98 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
+// Fetch the nth system call argument as a user array of cnt
+// iovecs and copy it into kiov, checking that every buffer
+// lies within the process address space.
+static int
+argiov(int n, int cnt, struct iovec *kiov)
+{
+  struct iovec *uiov;
+  struct proc *curproc = myproc();
+  uint base, len;
+  int i;
+
+  if(cnt < 0 || cnt > UIO_MAXIOV)
+    return -1;
+  if(argptr(n, (void*)&uiov, cnt*sizeof(uiov[0])) < 0)
+    return -1;
+  for(i = 0; i < cnt; i++){
+    base = (uint)uiov[i].iov_base;
+    len = uiov[i].iov_len;
+    if(len > curproc->sz || base > curproc->sz - len)
+      return -1;
+    kiov[i] = uiov[i];
+  }
+  return 0;
+}
+
+int
+sys_readv(void)
+{
+  struct file *f;
+  struct iovec iov[UIO_MAXIOV];
+  int cnt;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &cnt) < 0 || argiov(1, cnt, iov) < 0)
+    return -1;
+  return filereadv(f, iov, cnt, -1);
+}
+
+int
+sys_writev(void)
+{
+  struct file *f;
+  struct iovec iov[UIO_MAXIOV];
+  int cnt;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &cnt) < 0 || argiov(1, cnt, iov) < 0)
+    return -1;
+  return filewritev(f, iov, cnt, -1);
+}
+
+int
+sys_pread(void)
+{
+  struct file *f;
+  struct iovec iov;
+  int n, off;
+  char *p;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0 ||
+     argint(3, &off) < 0 || off < 0)
+    return -1;
+  iov.iov_base = p;
+  iov.iov_len = n;
+  return filereadv(f, &iov, 1, off);
+}
+
+int
+sys_pwrite(void)
+{
+  struct file *f;
+  struct iovec iov;
+  int n, off;
+  char *p;
+
+  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argptr(1, &p, n) < 0 ||
+     argint(3, &off) < 0 || off < 0)
+    return -1;
+  iov.iov_base = p;
+  iov.iov_len = n;
+  return filewritev(f, &iov, 1, off);
+}
+
 int
 sys_close(void)
 {
   int fd;
   struct file *f;
 
-  if(argfd(0, &fd, &f) < 0)
+  if(argfd(0, &fd, 0) < 0)
+    return -1;
+  // Another thread may close it first.
+  if((f = __sync_lock_test_and_set(&procfiles(myproc())[fd], 0)) == 0)
     return -1;
-  myproc()->ofile[fd] = 0;
   fileclose(f);
   return 0;
 }
@@ -241,7 +340,7 @@ bad:
 static struct inode*
 create(char *path, short type, short major, short minor)
 {
-  uint off;
+  uint off, inum;
   struct inode *ip, *dp;
   char name[DIRSIZ];
 
@@ -249,8 +348,11 @@ create(char *path, short type, short major, short minor)
     return 0;
   ilock(dp);
 
-  if((ip = dirlookup(dp, name, &off)) != 0){
+  if((inum = dirfind(dp, name, &off)) != 0){
+    ip = iget(dp->dev, inum);
     iunlockput(dp);
+    if(ip == 0)
+      return 0;
     ilock(ip);
     if(type == T_FILE && ip->type == T_FILE)
       return ip;
@@ -258,8 +360,11 @@ create(char *path, short type, short major, short minor)
     return 0;
   }
 
-  if((ip = ialloc(dp->dev, type)) == 0)
-    panic("create: ialloc");
+  // Out of memory for the inode.
+  if((ip = ialloc(dp->dev, type)) == 0){
+    iunlockput(dp);
+    return 0;
+  }
 
   ilock(ip);
   ip->major = major;
@@ -433,9 +538,10 @@ sys_pipe(void)
     return -1;
   fd0 = -1;
   if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
-    if(fd0 >= 0)
-      myproc()->ofile[fd0] = 0;
-    fileclose(rf);
+    // Unless another thread has closed it already.
+    if(fd0 < 0 ||
+       __sync_bool_compare_and_swap(&procfiles(myproc())[fd0], rf, 0))
+      fileclose(rf);
     fileclose(wf);
     return -1;
   }
@@ -443,3 +549,14 @@ sys_pipe(void)
   fd[1] = fd1;
   return 0;
 }
+
+int
+sys_logstat(void)
+{
+  struct logstat *st;
+
+  if(argptr(0, (void*)&st, sizeof(*st)) < 0)
+    return -1;
+  logstat(st);
+  return 0;
+}
@@ -10,6 +10,10 @@
 #include "pdx-kernel.h"
 #endif // PDX_XV6
 #include "uproc.h"
+#include "slabinfo.h"
+#include "membench.h"
+#include "lockstat.h"
+#include "schedtrace.h"
 #include "pdx.h"
 
 int sys_fork(void)
@@ -28,6 +32,62 @@ int sys_wait(void)
   return wait();
 }
 
+int sys_clone(void)
+{
+  int fcn, arg1, arg2, stack;
+
+  if (argint(0, &fcn) < 0 || argint(1, &arg1) < 0 ||
+      argint(2, &arg2) < 0 || argint(3, &stack) < 0)
+    return -1;
+  return clone((void (*)(void *, void *))fcn, (void *)arg1, (void *)arg2,
+               (void *)stack);
+}
+
+int sys_join(void)
+{
+  void **stack;
+
+  if (argptr(0, (void *)&stack, sizeof(*stack)) < 0)
+    return -1;
+  return join(stack);
+}
+
+int sys_sched_setaffinity(void)
+{
+  int pid, mask;
+
+  if (argint(0, &pid) < 0 || argint(1, &mask) < 0)
+    return -1;
+  return setaffinity(pid, (uint)mask);
+}
+
+int sys_sched_getaffinity(void)
+{
+  int pid;
+
+  if (argint(0, &pid) < 0)
+    return -1;
+  return getaffinity(pid);
+}
+
+int sys_futex_wait(void)
+{
+  int uaddr, val;
+
+  if (argint(0, &uaddr) < 0 || argint(1, &val) < 0)
+    return -1;
+  return futexwait((uint)uaddr, (uint)val);
+}
+
+int sys_futex_wake(void)
+{
+  int uaddr, n;
+
+  if (argint(0, &uaddr) < 0 || argint(1, &n) < 0)
+    return -1;
+  return futexwake((uint)uaddr, n);
+}
+
 int sys_kill(void)
 {
   int pid;
@@ -84,6 +144,60 @@ int sys_uptime(void)
   return xticks;
 }
 
+// return the number of slab caches, up to max, copied to info
+int sys_slabinfo(void)
+{
+  struct slabinfo *info;
+  int max;
+
+  if(argint(1, &max) < 0 || max < 1)
+    return -1;
+  if(max > NSLAB)
+    max = NSLAB;
+  if(argptr(0, (void*)&info, max * sizeof(*info)) < 0)
+    return -1;
+  return slabinfo(info, max);
+}
+
+// time the kernel's memmove() and memcmp() variants
+int sys_membench(void)
+{
+  struct membench *mb;
+
+  if(argptr(0, (void*)&mb, sizeof(*mb)) < 0)
+    return -1;
+  return membench(mb);
+}
+
+// return the number of spin locks, up to max, copied to ls
+int sys_lockstat(void)
+{
+  struct lockstat *ls;
+  int max;
+
+  if(argint(1, &max) < 0 || max < 1)
+    return -1;
+  if(max > NLOCKSTAT)
+    max = NLOCKSTAT;
+  if(argptr(0, (void*)&ls, max * sizeof(*ls)) < 0)
+    return -1;
+  return lockstat(ls, max);
+}
+
+int sys_schedtrace(void)
+{
+  struct schedevent *ev;
+  int max;
+
+  if(argint(1, &max) < 0 || max < 1)
+    return -1;
+  if(max > NCPU * NSCHEDTRACE)
+    max = NCPU * NSCHEDTRACE;
+  if(argptr(0, (void*)&ev, max * sizeof(*ev)) < 0)
+    return -1;
+  return schedtrace(ev, max);
+}
+
 #ifdef PDX_XV6
 // shutdown QEMU
 int sys_halt(void)
@@ -156,17 +270,28 @@ int sys_getprocs(void)
   {
     return -1;
   }
-  if (max != 1 && max != 16 && max != 64 && max != 72)
+  if (max < 1)
   {
     return -1;
   }
-  if (argptr(1, (void *)&table, sizeof(struct uproc)) < 0)
+  if (max > NPROC)
+  {
+    max = NPROC;
+  }
+  if (argptr(1, (void *)&table, max * sizeof(struct uproc)) < 0)
   {
     return -1;
   }
   int num_procs = getprocs(max, table);
   return num_procs;
 }
+int sys_cputime(void)
+{
+  struct cputime *ct;
+  if (argptr(0, (void *)&ct, sizeof(*ct)) < 0)
+    return -1;
+  return cputime(ct);
+}
 #endif // for p2
 #ifdef CS333_P4
 int sys_setpriority(void)
@@ -196,4 +321,41 @@ int sys_getpriority(void)
   int rc = getpriority(pid);
   return rc;
 }
+// Only root may change the policy for the whole machine.
+int sys_setscheduler(void)
+{
+  int policy;
+  if (argint(0, &policy) < 0)
+    return -1;
+  if (myproc()->uid != 0)
+    return -1;
+  return setscheduler(policy);
+}
+// Only root may change how the CPU is split between users.
+int sys_setshare(void)
+{
+  uint uid;
+  int weight;
+  if (argint(0, (int *)&uid) < 0 || argint(1, &weight) < 0)
+    return -1;
+  if (myproc()->uid != 0)
+    return -1;
+  if (uid < MIN_UID || uid > MAX_UID || weight < 1 || weight > MAX_SHARE)
+    return -1;
+  return setshare(uid, weight);
+}
+int sys_setdeadline(void)
+{
+  int runtime, period;
+  if (argint(0, &runtime) < 0 || argint(1, &period) < 0)
+    return -1;
+  // Reservations take CPU time from everyone else.
+  if (myproc()->uid != 0 && runtime != 0)
+    return -1;
+  return setdeadline(runtime, period);
+}
+int sys_rtwait(void)
+{
+  return rtwait();
+}
 #endif
\ No newline at end of file
@@ -1,6 +1,8 @@
 #ifdef CS333_P2
 #include "types.h"
 #include "user.h"
+#include "uproc.h"
+
 int main(int argc, char *argv[])
 {
     if (argc == 1)
@@ -9,7 +11,7 @@ int main(int argc, char *argv[])
     }
     else
     {
-        int time_1 = uptime();
+        int time_1 = vuptime();
         int pid = fork();
         if (pid > 0)
         {
@@ -22,7 +24,7 @@ int main(int argc, char *argv[])
             kill(getppid());
             exit();
         }
-        int time_2 = uptime();
+        int time_2 = vuptime();
         int time = time_2 - time_1;
         int m = time % 1000;
         char *zero = "";
@@ -34,8 +36,14 @@ int main(int argc, char *argv[])
         {
             zero = "00";
         }
-        printf(1, "%s run in %d.%s%d\n", argv[1], time / 1000, zero,
-               m);
+        // The command is the only child waited for, so all of the
+        // children's CPU time is its.
+        struct cputime ct;
+        if (cputime(&ct) < 0)
+            ct.children_ms = ct.children_us = 0;
+        printf(1, "%s run in %d.%s%d (CPU %d.%s%d%s%d)\n", argv[1], time / 1000, zero,
+               m, ct.children_ms / 1000, pad3(ct.children_ms % 1000),
+               ct.children_ms % 1000, pad3(ct.children_us), ct.children_us);
     }
     exit();
 }
@@ -11,6 +11,9 @@
 // Interrupt descriptor table (shared by all CPUs).
 struct gatedesc idt[256];
 extern uint vectors[];  // in vectors.S: array of 256 entry pointers
+extern char sysentry[]; // in trapasm.S: sysenter entry point
+extern char sysentryend[];
+int sysenter;           // the CPUs support sysenter
 #ifdef PDX_XV6
 // set alignment to 32-bit for ticks. See Intel® 64 and IA-32 Architectures
 // Software Developer’s Manual, Vol 3A, 8.1.1 Guaranteed Atomic Operations.
@@ -19,6 +22,10 @@ uint ticks __attribute__ ((aligned (4)));
 struct spinlock tickslock;
 uint ticks;
 #endif // PDX_XV6
+uint tscpertick;        // TSC cycles per tick, 0 until calibrated
+static uint64 tscstart;
+
+#define TSC_CALTICKS 100 // ticks to time the TSC against
 
 void
 tvinit(void)
@@ -40,6 +47,23 @@ idtinit(void)
   lidt(idt, sizeof(idt));
 }
 
+// Let user code make system calls with sysenter, if this CPU
+// has it. switchuvm() points MSR_SYSENTER_ESP at the kernel
+// stack of each process it runs.
+void
+sysenterinit(void)
+{
+  uint edx;
+
+  cpuinfo(1, 0, 0, 0, &edx);
+  if(!(edx & CPUID_SEP))
+    return;
+  wrmsr(MSR_SYSENTER_CS, SEG_KCODE<<3);
+  wrmsr(MSR_SYSENTER_EIP, (uint)sysentry);
+  wrmsr(MSR_SYSENTER_ESP, 0);
+  sysenter = 1;
+}
+
 //PAGEBREAK: 41
 void
 trap(struct trapframe *tf)
@@ -51,6 +75,8 @@ trap(struct trapframe *tf)
     syscall();
     if(myproc()->killed)
       exit();
+    if(needresched())
+      yield();
     return;
   }
 
@@ -66,9 +92,22 @@ trap(struct trapframe *tf)
       wakeup(&ticks);
       release(&tickslock);
 #endif // PDX_XV6
+      vdsotick(ticks % TPS == 0);
+      if(ticks == 1)
+        tscstart = rdtsc();
+      else if(ticks == 1 + TSC_CALTICKS)
+        tscpertick = (uint)(rdtsc() - tscstart) / TSC_CALTICKS;
     }
     lapiceoi();
     break;
+  case T_RESCHED:
+    // Just for the needresched check below, or to end a hlt.
+    lapiceoi();
+    break;
+  case T_TLBFLUSH:
+    tlbflushintr();
+    lapiceoi();
+    break;
   case T_IRQ0 + IRQ_IDE:
     ideintr();
     lapiceoi();
@@ -91,6 +130,16 @@ trap(struct trapframe *tf)
     lapiceoi();
     break;
 
+  case T_DEBUG:
+    // sysenter keeps the user's TF, so the kernel takes a
+    // single-step trap before sysentry clears it. Clear it here.
+    if((tf->cs&3) == 0 && tf->eip >= (uint)sysentry &&
+       tf->eip < (uint)sysentryend){
+      tf->eflags &= ~FL_TF;
+      return;
+    }
+    // fall through
+
   //PAGEBREAK: 13
   default:
     if(myproc() == 0 || (tf->cs&3) == 0){
@@ -115,14 +164,22 @@ trap(struct trapframe *tf)
 
   // Force process to give up CPU on clock tick.
   // If interrupts were on while locks held, would need to check nlock.
+  // Real-time processes preempt at any tick (see rtpreempt).
   if(myproc() && myproc()->state == RUNNING &&
-#ifdef PDX_XV6
+#if defined(CS333_P4)
+    tf->trapno == T_IRQ0+IRQ_TIMER &&
+    (ticks%SCHED_INTERVAL==0 || rtpreempt(myproc())))
+#elif defined(PDX_XV6)
     tf->trapno == T_IRQ0+IRQ_TIMER && ticks%SCHED_INTERVAL==0)
 #else
     tf->trapno == T_IRQ0+IRQ_TIMER)
 #endif // PDX_XV6
     yield();
 
+  // Make way for a process woken up that outranks this one.
+  if(myproc() && myproc()->state == RUNNING && needresched())
+    yield();
+
   // Check if the process has been killed since we yielded
   if(myproc() && myproc()->killed && (tf->cs&3) == DPL_USER)
     exit();
@@ -0,0 +1,9 @@
+// Scatter/gather vectors for readv() and writev().
+// Both the kernel and user programs use this header file.
+
+#define UIO_MAXIOV 16  // max iovec entries in one readv/writev
+
+struct iovec {
+  void *iov_base;  // start of user buffer
+  uint iov_len;    // length of buffer in bytes
+};
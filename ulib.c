@@ -3,6 +3,27 @@
 #include "fcntl.h"
 #include "user.h"
 #include "x86.h"
+#include "mmu.h"
+#include "memlayout.h"
+#include "date.h"
+#include "vdso.h"
+
+// Nonzero if some byte of the word w is zero.
+#define HASZERO(w) (((w) - 0x01010101) & ~(w) & 0x80808080)
+
+// Does the CPU have SSE2? The kernel turns SSE on if so.
+static int
+usesse2(void)
+{
+  static int sse2 = -1;
+  uint edx;
+
+  if(sse2 < 0){
+    cpuinfo(1, 0, 0, 0, &edx);
+    sse2 = (edx & CPUID_SSE2) != 0;
+  }
+  return sse2;
+}
 
 char*
 strcpy(char *s, char *t)
@@ -15,35 +36,120 @@ strcpy(char *s, char *t)
   return os;
 }
 
+// Compare a word at a time once p is aligned, if q is too.
 int
 strcmp(const char *p, const char *q)
 {
+  for(; (uint)p % 4; p++, q++)
+    if(*p == 0 || *p != *q)
+      return (uchar)*p - (uchar)*q;
+  if((uint)q % 4 == 0)
+    for(; *(uint*)p == *(uint*)q && !HASZERO(*(uint*)p); p += 4, q += 4)
+      ;
   while(*p && *p == *q)
     p++, q++;
   return (uchar)*p - (uchar)*q;
 }
 
+// The SSE2 loops of strlen() and memmove(), for callers that
+// have checked usesse2(). The target attribute lets their asm
+// name the XMM registers it clobbers.
+
+// Find the NUL at or after p, which is 16-byte aligned.
+__attribute__((target("sse2")))
+static char*
+sse2nul(char *p)
+{
+  uint mask;
+
+  for(;; p += 16){
+    asm("pxor %%xmm0, %%xmm0\n\t"
+        "pcmpeqb (%1), %%xmm0\n\t"
+        "pmovmskb %%xmm0, %0" : "=r" (mask) : "r" (p)
+        : "memory", "xmm0");
+    if(mask)
+      return p + __builtin_ctz(mask);
+  }
+}
+
+// Copy n/64 blocks of 64 bytes from src to dst, which is
+// 16-byte aligned.
+__attribute__((target("sse2")))
+static void
+sse2move(char *dst, char *src, int n)
+{
+  for(; n >= 64; n -= 64, dst += 64, src += 64)
+    asm volatile("movdqu 0(%1), %%xmm0\n\t"
+                 "movdqu 16(%1), %%xmm1\n\t"
+                 "movdqu 32(%1), %%xmm2\n\t"
+                 "movdqu 48(%1), %%xmm3\n\t"
+                 "movdqa %%xmm0, 0(%0)\n\t"
+                 "movdqa %%xmm1, 16(%0)\n\t"
+                 "movdqa %%xmm2, 32(%0)\n\t"
+                 "movdqa %%xmm3, 48(%0)" :
+                 : "r" (dst), "r" (src)
+                 : "memory", "xmm0", "xmm1", "xmm2", "xmm3");
+}
+
+// Aligned loads never cross into the next page, so reading a
+// whole word or 16 bytes past the terminating NUL is safe.
 uint
 strlen(char *s)
 {
-  int n;
+  char *p;
+  uint *w;
 
-  for(n = 0; s[n]; n++)
+  p = s;
+  if(usesse2()){
+    for(; (uint)p % 16; p++)
+      if(*p == 0)
+        return p - s;
+    return sse2nul(p) - s;
+  }
+  for(; (uint)p % 4; p++)
+    if(*p == 0)
+      return p - s;
+  for(w = (uint*)p; !HASZERO(*w); w++)
     ;
-  return n;
+  for(p = (char*)w; *p; p++)
+    ;
+  return p - s;
 }
 
 void*
 memset(void *dst, int c, uint n)
 {
-  stosb(dst, c, n);
+  char *d;
+  uint head;
+
+  d = dst;
+  if(n >= 16){
+    head = (4 - (uint)d % 4) % 4;
+    stosb(d, c, head);
+    d += head, n -= head;
+    c &= 0xFF;
+    stosl(d, (c<<24)|(c<<16)|(c<<8)|c, n/4);
+    d += n & ~3, n %= 4;
+  }
+  stosb(d, c, n);
   return dst;
 }
 
 char*
 strchr(const char *s, char c)
 {
-  for(; *s; s++)
+  uint *w, cc;
+
+  for(; (uint)s % 4; s++){
+    if(*s == 0)
+      return 0;
+    if(*s == c)
+      return (char*)s;
+  }
+  cc = (uchar)c * 0x01010101;
+  for(w = (uint*)s; !HASZERO(*w) && !HASZERO(*w ^ cc); w++)
+    ;
+  for(s = (char*)w; *s; s++)
     if(*s == c)
       return (char*)s;
   return 0;
@@ -134,14 +240,79 @@ atoi(const char *s)
 }
 #endif // PDX_XV6
 
+// Zeros that pad v, below 1000, to three digits.
+char*
+pad3(uint v)
+{
+  if(v < 10)
+    return "00";
+  if(v < 100)
+    return "0";
+  return "";
+}
+
+// Copy backwards when dst overlaps the end of src, otherwise
+// forwards: 64 bytes at a time with SSE2 for big copies, then
+// a word at a time.
 void*
 memmove(void *vdst, void *vsrc, int n)
 {
   char *dst, *src;
+  int head, words;
 
   dst = vdst;
   src = vsrc;
-  while(n-- > 0)
+  if(n <= 0)
+    return vdst;
+  if(src < dst && src + n > dst){
+    dst += n;
+    src += n;
+    while(n-- > 0)
+      *--dst = *--src;
+    return vdst;
+  }
+  if(n >= 256 && (dst + n <= src || src + n <= dst) && usesse2()){
+    head = (16 - (uint)dst % 16) % 16;
+    n -= head;
+    while(head-- > 0)
+      *dst++ = *src++;
+    sse2move(dst, src, n);
+    dst += n & ~63;
+    src += n & ~63;
+    n %= 64;
+  }
+  words = n/4;
+  asm volatile("cld; rep movsl" :
+               "+D" (dst), "+S" (src), "+c" (words) : : "memory", "cc");
+  for(n %= 4; n > 0; n--)
     *dst++ = *src++;
   return vdst;
 }
+
+// Read the vdso.h pages instead of making system calls.
+int
+vuptime(void)
+{
+  return ((volatile struct vdsotime*)VDSOTIME)->ticks;
+}
+
+void
+vdate(struct rtcdate *r)
+{
+  volatile struct vdsotime *vt = (struct vdsotime*)VDSOTIME;
+  uint seq;
+
+  do {
+    while((seq = vt->seq) & 1)
+      ;
+    *r = vt->date;
+  } while(vt->seq != seq);
+}
+
+// The pid of the process that owns the memory: in a thread, that
+// is the process's pid, not the thread's own getpid().
+int
+vgetpid(void)
+{
+  return ((struct vdsoproc*)VDSOPROC)->pid;
+}
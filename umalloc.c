@@ -4,7 +4,14 @@
 #include "param.h"
 
 // Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// The C programming Language, 2nd ed.  Section 8.7,
+// with a free list per size for small blocks.
+//
+// Blocks of up to NSMALL units are never coalesced: free()
+// pushes them on small[size] and malloc() pops them, carving
+// SMALLBATCH bytes at a time from the large list when one runs
+// dry. Larger blocks use the address-ordered first-fit list.
+// One lock covers all the lists, so threads may share them.
 
 typedef long Align;
 
@@ -18,15 +25,19 @@ union header {
 
 typedef union header Header;
 
+#define NSMALL 64         // largest small block, in units
+#define SMALLBATCH 2048   // bytes carved at once for small[]
+
 static Header base;
 static Header *freep;
+static Header *small[NSMALL+1];
+static lock_t lock;
 
-void
-free(void *ap)
+static void
+bigfree(Header *bp)
 {
-  Header *bp, *p;
+  Header *p;
 
-  bp = (Header*)ap - 1;
   for(p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
     if(p >= p->s.ptr && (bp > p || bp < p->s.ptr))
       break;
@@ -43,6 +54,21 @@ free(void *ap)
   freep = p;
 }
 
+void
+free(void *ap)
+{
+  Header *bp;
+
+  bp = (Header*)ap - 1;
+  lock_acquire(&lock);
+  if(bp->s.size <= NSMALL){
+    bp->s.ptr = small[bp->s.size];
+    small[bp->s.size] = bp;
+  } else
+    bigfree(bp);
+  lock_release(&lock);
+}
+
 static Header*
 morecore(uint nu)
 {
@@ -56,17 +82,16 @@ morecore(uint nu)
     return 0;
   hp = (Header*)p;
   hp->s.size = nu;
-  free((void*)(hp + 1));
+  bigfree(hp);
   return freep;
 }
 
-void*
-malloc(uint nbytes)
+// Take a block of exactly nunits from the large list.
+static Header*
+bigalloc(uint nunits)
 {
   Header *p, *prevp;
-  uint nunits;
 
-  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
   if((prevp = freep) == 0){
     base.s.ptr = freep = prevp = &base;
     base.s.size = 0;
@@ -81,10 +106,67 @@ malloc(uint nbytes)
         p->s.size = nunits;
       }
       freep = prevp;
-      return (void*)(p + 1);
+      return p;
     }
     if(p == freep)
       if((p = morecore(nunits)) == 0)
         return 0;
   }
 }
+
+// Fill small[nunits] with blocks cut from one large block.
+static int
+smallrefill(uint nunits)
+{
+  Header *p, *q;
+  uint i, n;
+
+  n = SMALLBATCH / (nunits * sizeof(Header));
+  if((p = bigalloc(n * nunits)) == 0)
+    return -1;
+  for(i = 0; i < n; i++){
+    q = p + i*nunits;
+    q->s.size = nunits;
+    q->s.ptr = small[nunits];
+    small[nunits] = q;
+  }
+  return 0;
+}
+
+void*
+malloc(uint nbytes)
+{
+  Header *p;
+  uint nunits;
+
+  nunits = (nbytes + sizeof(Header) - 1)/sizeof(Header) + 1;
+  lock_acquire(&lock);
+  if(nunits > NSMALL)
+    p = bigalloc(nunits);
+  else if(small[nunits] == 0 && smallrefill(nunits) < 0)
+    p = 0;
+  else {
+    p = small[nunits];
+    small[nunits] = p->s.ptr;
+  }
+  lock_release(&lock);
+  return p ? (void*)(p + 1) : 0;
+}
+
+void*
+realloc(void *ap, uint nbytes)
+{
+  Header *bp;
+  void *np;
+
+  if(ap == 0)
+    return malloc(nbytes);
+  bp = (Header*)ap - 1;
+  if((nbytes + sizeof(Header) - 1)/sizeof(Header) + 1 <= bp->s.size)
+    return ap;
+  if((np = malloc(nbytes)) == 0)
+    return 0;
+  memmove(np, ap, (bp->s.size - 1) * sizeof(Header));
+  free(ap);
+  return np;
+}
@@ -11,7 +11,16 @@ struct uproc
 #endif // CS333_P4
   uint elapsed_ticks;
   uint CPU_total_ticks;
+  uint CPU_total_usec; // microseconds on top of CPU_total_ticks
   char state[STRMAX];
   uint size;
+  uint migrations;
   char name[STRMAX];
 };
+
+// CPU time from cputime(), in milliseconds and microseconds.
+struct cputime
+{
+  uint ms, us;                   // the caller
+  uint children_ms, children_us; // its children it has waited for
+};
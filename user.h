@@ -5,6 +5,13 @@
 struct stat;
 struct rtcdate;
 struct uproc;
+struct cputime;
+struct iovec;
+struct logstat;
+struct slabinfo;
+struct membench;
+struct lockstat;
+struct schedevent;
 
 // system calls
 int fork(void);
@@ -29,6 +36,21 @@ char *sbrk(int);
 int sleep(int);
 int uptime(void);
 int halt(void);
+int readv(int, struct iovec *, int);
+int writev(int, struct iovec *, int);
+int pread(int, void *, int, int);
+int pwrite(int, void *, int, int);
+int logstat(struct logstat *);
+int slabinfo(struct slabinfo *, int);
+int membench(struct membench *);
+int lockstat(struct lockstat *, int);
+int clone(void (*)(void *, void *), void *, void *, void *);
+int join(void **);
+int futex_wait(uint *, uint);
+int futex_wake(uint *, int);
+int sched_setaffinity(int pid, uint mask);
+int sched_getaffinity(int pid);
+int schedtrace(struct schedevent *, int);
 
 // ulib.c
 int stat(char *, struct stat *);
@@ -42,7 +64,37 @@ uint strlen(char *);
 void *memset(void *, int, uint);
 void *malloc(uint);
 void free(void *);
+void *realloc(void *, uint);
 int atoi(const char *);
+char *pad3(uint);
+int vuptime(void);
+void vdate(struct rtcdate *);
+int vgetpid(void);
+
+// uthread.c
+typedef struct {
+  uint locked;
+} lock_t;
+// fcn must call exit() rather than return.
+int thread_create(void (*fcn)(void *, void *), void *, void *);
+int thread_join(void);
+void lock_init(lock_t *);
+void lock_acquire(lock_t *);
+void lock_release(lock_t *);
+typedef struct {
+  uint state;  // 0 free, 1 held, 2 held with waiters
+} mutex_t;
+typedef struct {
+  uint seq;
+} cond_t;
+void mutex_init(mutex_t *);
+void mutex_lock(mutex_t *);
+void mutex_unlock(mutex_t *);
+void cond_init(cond_t *);
+void cond_wait(cond_t *, mutex_t *);
+void cond_signal(cond_t *);
+void cond_broadcast(cond_t *);
+
 #ifdef PDX_XV6
 int atoo(const char *);
 int strncmp(const char *, const char *, uint);
@@ -58,8 +110,13 @@ uint getppid(void);
 int setuid(uint);
 int setgid(uint);
 int getprocs(uint max, struct uproc *table);
+int cputime(struct cputime *ct);
 #endif //CS 333 P2
 #ifdef CS333_P4
 int setpriority(int pid, int priority);
 int getpriority(int pid);
+int setscheduler(int policy);
+int setshare(uint uid, int weight);
+int setdeadline(int runtime, int period);
+int rtwait(void);
 #endif
\ No newline at end of file
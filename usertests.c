@@ -7,12 +7,493 @@
 #include "syscall.h"
 #include "traps.h"
 #include "memlayout.h"
+#include "uio.h"
+#include "slabinfo.h"
 
 char buf[8192];
 char name[3];
 char *echoargv[] = { "echo", "ALL", "TESTS", "PASSED", 0 };
 int stdout = 1;
 
+// the vdso.h pages agree with the system calls and are read-only.
+void
+vdsotest(void)
+{
+  int pid, t, fds[2];
+  char c;
+
+  printf(stdout, "vdso test\n");
+  if(vgetpid() != getpid()){
+    printf(stdout, "vgetpid wrong\n");
+    exit();
+  }
+  t = uptime();
+  if(vuptime() + 1 < t || vuptime() > uptime()){
+    printf(stdout, "vuptime wrong\n");
+    exit();
+  }
+  // The child reports a failure on the pipe; the store should
+  // kill it before it can.
+  if(pipe(fds) < 0){
+    printf(stdout, "pipe failed\n");
+    exit();
+  }
+  pid = fork();
+  if(pid < 0){
+    printf(stdout, "fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    close(fds[0]);
+    if(vgetpid() != getpid()){
+      write(fds[1], "p", 1);
+      exit();
+    }
+    *(int*)VDSOPROC = 0;
+    write(fds[1], "w", 1);
+    exit();
+  }
+  close(fds[1]);
+  wait();
+  if(read(fds[0], &c, 1) == 1){
+    printf(stdout, c == 'p' ? "vgetpid wrong in child\n" :
+           "vdso page is writable\n");
+    exit();
+  }
+  close(fds[0]);
+  printf(stdout, "vdso test ok\n");
+}
+
+// sysenter with the trap flag set must not single-step the kernel.
+void
+sysentertftest(void)
+{
+  uint eax, ebx, ecx, edx;
+  int pid, fds[2];
+  char c;
+
+  printf(stdout, "sysenter TF test\n");
+  asm volatile("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+               : "a" (1));
+  if(!(edx & 0x800)){
+    printf(stdout, "no sysenter\n");
+    return;
+  }
+  // The child reports success on the pipe, unless the kernel
+  // panics or a user single-step trap kills it.
+  if(pipe(fds) < 0){
+    printf(stdout, "pipe failed\n");
+    exit();
+  }
+  pid = fork();
+  if(pid < 0){
+    printf(stdout, "fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    close(fds[0]);
+    asm volatile("movl %%esp, %%ecx\n\t"
+                 "movl $1f, %%edx\n\t"
+                 "pushfl\n\t"
+                 "orl $0x100, (%%esp)\n\t"  // FL_TF
+                 "popfl\n\t"
+                 "sysenter\n"
+                 "1:"
+                 : "=a" (eax) : "a" (SYS_getpid)
+                 : "ecx", "edx", "memory", "cc");
+    if(eax == getpid())
+      write(fds[1], "k", 1);
+    exit();
+  }
+  close(fds[1]);
+  wait();
+  if(read(fds[0], &c, 1) != 1){
+    printf(stdout, "sysenter with TF set failed\n");
+    exit();
+  }
+  close(fds[0]);
+  printf(stdout, "sysenter TF test ok\n");
+}
+
+// objects in use in the named slab cache, or -1
+int
+slabinuse(char *name)
+{
+  static struct slabinfo info[NSLAB];
+  int i, n;
+
+  n = slabinfo(info, NSLAB);
+  for(i = 0; i < n; i++)
+    if(strcmp(info[i].name, name) == 0)
+      return info[i].inuse;
+  return -1;
+}
+
+// do pipes and files go back to their slab caches?
+void
+slabtest(void)
+{
+  int i, fds[2], files, pipes;
+
+  printf(stdout, "slab test\n");
+  files = slabinuse("file");
+  pipes = slabinuse("kmalloc-1024");
+  if(files < 0 || pipes < 0){
+    printf(stdout, "slabinfo failed\n");
+    exit();
+  }
+  for(i = 0; i < 100; i++){
+    if(pipe(fds) != 0){
+      printf(stdout, "pipe failed\n");
+      exit();
+    }
+    close(fds[0]);
+    close(fds[1]);
+  }
+  if(slabinuse("file") != files || slabinuse("kmalloc-1024") != pipes){
+    printf(stdout, "slab objects leaked\n");
+    exit();
+  }
+  printf(stdout, "slab test ok\n");
+}
+
+int threadcount;
+lock_t threadlock;
+
+// Count to arg1 under threadlock; grow memory if arg2 says where
+// to put the old break.
+void
+threadworker(void *arg1, void *arg2)
+{
+  int i;
+
+  for(i = 0; i < (int)arg1; i++){
+    lock_acquire(&threadlock);
+    threadcount++;
+    lock_release(&threadlock);
+  }
+  if(arg2)
+    *(char**)arg2 = sbrk(4096);
+  exit();
+}
+
+// Open a file for the process, and note what getpid() and
+// vgetpid() say in a thread.
+void
+threadopener(void *arg1, void *arg2)
+{
+  int *pids = arg2;
+
+  *(int*)arg1 = open("threadfile", O_CREATE|O_RDWR);
+  pids[0] = getpid();
+  pids[1] = vgetpid();
+  exit();
+}
+
+// Read a byte from the pipe arg1.
+void
+threadreader(void *arg1, void *arg2)
+{
+  char c;
+
+  read((int)arg1, &c, 1);
+  exit();
+}
+
+void
+threadspinner(void *arg1, void *arg2)
+{
+  for(;;)
+    ;
+}
+
+// threads share memory, are joined rather than waited for,
+// and die with the process that owns them.
+void
+threadtest(void)
+{
+  char *brk;
+  int i, pid, fd, pids[2], fds[2];
+
+  printf(stdout, "thread test\n");
+  lock_init(&threadlock);
+  threadcount = 0;
+  brk = 0;
+  for(i = 0; i < 4; i++){
+    if(thread_create(threadworker, (void*)1000, i == 0 ? &brk : 0) < 0){
+      printf(stdout, "thread_create failed\n");
+      exit();
+    }
+  }
+  for(i = 0; i < 4; i++){
+    if(thread_join() < 0){
+      printf(stdout, "thread_join failed\n");
+      exit();
+    }
+  }
+  if(thread_join() != -1){
+    printf(stdout, "thread_join with no threads succeeded\n");
+    exit();
+  }
+  if(threadcount != 4000){
+    printf(stdout, "threads counted %d, not 4000\n", threadcount);
+    exit();
+  }
+  if(brk == 0 || brk == (char*)-1 || sbrk(0) < brk + 4096){
+    printf(stdout, "sbrk in thread not seen\n");
+    exit();
+  }
+  brk[4095] = 1;
+
+  // Threads share open files, and vgetpid() gives the process's pid.
+  fd = -1;
+  if(thread_create(threadopener, &fd, pids) < 0 || thread_join() < 0){
+    printf(stdout, "thread_create failed\n");
+    exit();
+  }
+  if(fd < 0 || write(fd, "x", 1) != 1 || close(fd) != 0){
+    printf(stdout, "file opened in thread not shared\n");
+    exit();
+  }
+  unlink("threadfile");
+  if(pids[0] == getpid() || pids[1] != getpid()){
+    printf(stdout, "thread getpid %d vgetpid %d, process %d\n",
+           pids[0], pids[1], getpid());
+    exit();
+  }
+
+  // sbrk() cannot free memory while a thread is in a system
+  // call that may be using it.
+  if(pipe(fds) < 0 || thread_create(threadreader, (void*)fds[0], 0) < 0 ||
+     sbrk(4096) == (char*)-1){
+    printf(stdout, "thread_create failed\n");
+    exit();
+  }
+  sleep(10);
+  if(sbrk(-4096) != (char*)-1){
+    printf(stdout, "sbrk shrank under a thread's read\n");
+    exit();
+  }
+  write(fds[1], "x", 1);
+  if(thread_join() < 0 || sbrk(-4096) == (char*)-1){
+    printf(stdout, "thread read or shrink after it failed\n");
+    exit();
+  }
+  close(fds[0]);
+  close(fds[1]);
+
+  pid = fork();
+  if(pid < 0){
+    printf(stdout, "fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    if(thread_create(threadspinner, 0, 0) < 0){
+      printf(stdout, "thread_create failed\n");
+      exit();
+    }
+    if(wait() != -1)
+      printf(stdout, "wait returned a thread\n");
+    exit();
+  }
+  if(wait() != pid){
+    printf(stdout, "wait for threaded process failed\n");
+    exit();
+  }
+  printf(stdout, "thread test ok\n");
+}
+
+// sched_setaffinity() limits where a process runs, and fork
+// passes the limit on.
+void
+affinitytest(void)
+{
+  int all, pid, fds[2];
+  char c;
+
+  printf(stdout, "affinity test\n");
+  all = sched_getaffinity(getpid());
+  if(all <= 0 || sched_getaffinity(-1) != -1){
+    printf(stdout, "sched_getaffinity failed\n");
+    exit();
+  }
+  if(sched_setaffinity(getpid(), 0) != -1 || sched_setaffinity(-1, 1) != -1){
+    printf(stdout, "bad sched_setaffinity succeeded\n");
+    exit();
+  }
+  if(sched_setaffinity(getpid(), 1) != 0 || sched_getaffinity(getpid()) != 1){
+    printf(stdout, "sched_setaffinity failed\n");
+    exit();
+  }
+  // The child reports a failure on the pipe.
+  if(pipe(fds) < 0){
+    printf(stdout, "pipe failed\n");
+    exit();
+  }
+  pid = fork();
+  if(pid < 0){
+    printf(stdout, "fork failed\n");
+    exit();
+  }
+  if(pid == 0){
+    close(fds[0]);
+    if(sched_getaffinity(getpid()) != 1)
+      write(fds[1], "a", 1);
+    exit();
+  }
+  close(fds[1]);
+  wait();
+  if(read(fds[0], &c, 1) == 1){
+    printf(stdout, "child did not inherit affinity\n");
+    exit();
+  }
+  close(fds[0]);
+  if(sched_setaffinity(getpid(), all) != 0){
+    printf(stdout, "sched_setaffinity failed\n");
+    exit();
+  }
+  printf(stdout, "affinity test ok\n");
+}
+
+mutex_t futexmutex;
+cond_t futexcond;
+int futexitems;
+
+// Count to arg1 under futexmutex, or consume arg1 items posted
+// to futexcond if arg2 is set.
+void
+futexworker(void *arg1, void *arg2)
+{
+  int i;
+
+  for(i = 0; i < (int)arg1; i++){
+    mutex_lock(&futexmutex);
+    if(arg2){
+      while(futexitems == 0)
+        cond_wait(&futexcond, &futexmutex);
+      futexitems--;
+    } else
+      threadcount++;
+    mutex_unlock(&futexmutex);
+  }
+  exit();
+}
+
+// futex-based mutexes and condition variables.
+void
+futextest(void)
+{
+  uint word;
+  int i;
+
+  printf(stdout, "futex test\n");
+  word = 1;
+  if(futex_wait(&word, 0) != -1 || futex_wake(&word, 1) != 0){
+    printf(stdout, "futex on a changed word blocked or woke\n");
+    exit();
+  }
+  if(futex_wait((uint*)0x7ffffff0, 0) != -1 ||
+     futex_wake((uint*)0x7ffffff0, 1) != -1){
+    printf(stdout, "futex on a bad address succeeded\n");
+    exit();
+  }
+  if(futex_wait((uint*)((char*)&word + 1), 0) != -1 ||
+     futex_wake((uint*)((char*)&word + 1), 1) != -1){
+    printf(stdout, "futex on a misaligned address succeeded\n");
+    exit();
+  }
+
+  mutex_init(&futexmutex);
+  cond_init(&futexcond);
+  threadcount = 0;
+  for(i = 0; i < 4; i++)
+    if(thread_create(futexworker, (void*)1000, 0) < 0){
+      printf(stdout, "thread_create failed\n");
+      exit();
+    }
+  for(i = 0; i < 4; i++)
+    thread_join();
+  if(threadcount != 4000){
+    printf(stdout, "futex mutex counted %d, not 4000\n", threadcount);
+    exit();
+  }
+
+  futexitems = 0;
+  for(i = 0; i < 2; i++)
+    if(thread_create(futexworker, (void*)100, (void*)1) < 0){
+      printf(stdout, "thread_create failed\n");
+      exit();
+    }
+  for(i = 0; i < 200; i++){
+    mutex_lock(&futexmutex);
+    futexitems++;
+    cond_signal(&futexcond);
+    mutex_unlock(&futexmutex);
+  }
+  for(i = 0; i < 2; i++)
+    thread_join();
+  if(futexitems != 0){
+    printf(stdout, "futex cond left %d items\n", futexitems);
+    exit();
+  }
+  printf(stdout, "futex test ok\n");
+}
+
+// several processes read one file at once under the shared
+// inode lock, while another appends to it.
+void
+sharedreadtest(void)
+{
+  int fd, i, j, n, pid;
+
+  printf(stdout, "shared read test\n");
+  unlink("sharedread");
+  fd = open("sharedread", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf(stdout, "create sharedread failed\n");
+    exit();
+  }
+  for(i = 0; i < sizeof(buf); i++)
+    buf[i] = i % 251;
+  for(i = 0; i < 4; i++)
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      printf(stdout, "write sharedread failed\n");
+      exit();
+    }
+  close(fd);
+
+  for(i = 0; i < 4; i++){
+    pid = fork();
+    if(pid < 0){
+      printf(stdout, "fork failed\n");
+      exit();
+    }
+    if(pid == 0){
+      if(i == 0){
+        fd = open("sharedread", O_WRONLY);
+        for(j = 0; j < 20; j++)
+          pwrite(fd, buf, 512, 4*sizeof(buf));
+        close(fd);
+        exit();
+      }
+      for(j = 0; j < 20; j++){
+        fd = open("sharedread", O_RDONLY);
+        while((n = read(fd, buf, sizeof(buf))) > 0)
+          if(buf[0] != 0 || buf[n-1] != (char)((n-1) % 251)){
+            printf(stdout, "sharedread: wrong data\n");
+            exit();
+          }
+        close(fd);
+      }
+      exit();
+    }
+  }
+  for(i = 0; i < 4; i++)
+    wait();
+  unlink("sharedread");
+  printf(stdout, "shared read test ok\n");
+}
+
 // does chdir() call iput(p->cwd) in a transaction?
 void
 iputtest(void)
@@ -241,6 +722,91 @@ writetest1(void)
   printf(stdout, "big files ok\n");
 }
 
+// readv/writev gather and scatter in order, and pread/pwrite
+// leave the shared file offset alone.
+void
+iovtest(void)
+{
+  int fd, i;
+  struct iovec iov[3];
+  static char a[10], b[600], c[2000];
+
+  printf(stdout, "iov test\n");
+
+  fd = open("iovfile", O_CREATE|O_RDWR);
+  if(fd < 0){
+    printf(stdout, "error: creat iovfile failed!\n");
+    exit();
+  }
+  memset(a, 'a', sizeof(a));
+  memset(b, 'b', sizeof(b));
+  memset(c, 'c', sizeof(c));
+  iov[0].iov_base = a;
+  iov[0].iov_len = sizeof(a);
+  iov[1].iov_base = b;
+  iov[1].iov_len = sizeof(b);
+  iov[2].iov_base = c;
+  iov[2].iov_len = sizeof(c);
+  if(writev(fd, iov, 3) != sizeof(a) + sizeof(b) + sizeof(c)){
+    printf(stdout, "error: writev failed\n");
+    exit();
+  }
+  if(pwrite(fd, "XY", 2, 5) != 2){
+    printf(stdout, "error: pwrite failed\n");
+    exit();
+  }
+  // the shared offset is still at the end of the file
+  if(write(fd, "z", 1) != 1){
+    printf(stdout, "error: write after pwrite failed\n");
+    exit();
+  }
+  close(fd);
+
+  fd = open("iovfile", O_RDONLY);
+  if(fd < 0){
+    printf(stdout, "error: open iovfile failed!\n");
+    exit();
+  }
+  if(pread(fd, a, 4, 4) != 4 || a[0] != 'a' || a[1] != 'X' ||
+     a[2] != 'Y' || a[3] != 'a'){
+    printf(stdout, "error: pread wrong data\n");
+    exit();
+  }
+  i = sizeof(a) + sizeof(b) + sizeof(c) + 1;
+  if(pread(fd, a, 4, i) != 0 || pread(fd, a, 4, i + 100) != 0){
+    printf(stdout, "error: pread at or past EOF did not return 0\n");
+    exit();
+  }
+  iov[0].iov_base = c;
+  iov[0].iov_len = 5;
+  iov[1].iov_base = b;
+  iov[1].iov_len = sizeof(b);
+  iov[2].iov_base = buf;
+  iov[2].iov_len = sizeof(buf);
+  i = readv(fd, iov, 3);
+  if(i != sizeof(a) + sizeof(b) + sizeof(c) + 1){
+    printf(stdout, "error: readv returned %d\n", i);
+    exit();
+  }
+  if(c[0] != 'a' || c[4] != 'a' || b[0] != 'X' || b[1] != 'Y' ||
+     b[5] != 'b' || buf[0] != 'b' || buf[4] != 'b' || buf[5] != 'c' ||
+     buf[sizeof(c) + 4] != 'c' || buf[sizeof(c) + 5] != 'z'){
+    printf(stdout, "error: readv wrong data\n");
+    exit();
+  }
+  if(read(fd, buf, 1) != 0){
+    printf(stdout, "error: readv did not advance offset\n");
+    exit();
+  }
+  close(fd);
+
+  if(unlink("iovfile") < 0){
+    printf(stdout, "unlink iovfile failed\n");
+    exit();
+  }
+  printf(stdout, "iov test ok\n");
+}
+
 void
 createtest(void)
 {
@@ -1383,7 +1949,8 @@ forktest(void)
 
   printf(1, "fork test\n");
 
-  for(n=0; n<1000; n++){
+  // NPROC + 1 is more than the kernel can have.
+  for(n=0; n<NPROC+1; n++){
     pid = fork();
     if(pid < 0)
       break;
@@ -1391,8 +1958,8 @@ forktest(void)
       exit();
   }
 
-  if(n == 1000){
-    printf(1, "fork claimed to work 1000 times!\n");
+  if(n == NPROC+1){
+    printf(1, "fork claimed to work %d times!\n", n);
     exit();
   }
 
@@ -1774,6 +2341,14 @@ main(int argc, char *argv[])
   writetest();
   writetest1();
   createtest();
+  iovtest();
+  vdsotest();
+  sysentertftest();
+  slabtest();
+  sharedreadtest();
+  threadtest();
+  futextest();
+  affinitytest();
 
   openiputtest();
   exitiputtest();
@@ -0,0 +1,125 @@
+// User threads built on clone() and join(), and spin locks,
+// mutexes and condition variables for them to share data with.
+
+#include "types.h"
+#include "user.h"
+#include "x86.h"
+#include "mmu.h"
+
+void
+lock_init(lock_t *lk)
+{
+  lk->locked = 0;
+}
+
+void
+lock_acquire(lock_t *lk)
+{
+  while(xchg(&lk->locked, 1) != 0)
+    pause();
+}
+
+void
+lock_release(lock_t *lk)
+{
+  xchg(&lk->locked, 0);
+}
+
+// Mutexes sleep in the kernel with futex_wait() instead of
+// spinning, but only once the lock is contended: state 1 means
+// held with nobody waiting, so an uncontended lock and unlock
+// are one atomic instruction each and no system call.
+void
+mutex_init(mutex_t *m)
+{
+  m->state = 0;
+}
+
+void
+mutex_lock(mutex_t *m)
+{
+  uint c;
+
+  if((c = __sync_val_compare_and_swap(&m->state, 0, 1)) == 0)
+    return;
+  if(c != 2)
+    c = xchg(&m->state, 2);
+  while(c != 0){
+    futex_wait(&m->state, 2);
+    c = xchg(&m->state, 2);
+  }
+}
+
+void
+mutex_unlock(mutex_t *m)
+{
+  if(__sync_fetch_and_sub(&m->state, 1) != 1){
+    m->state = 0;
+    futex_wake(&m->state, 1);
+  }
+}
+
+// Condition variables count signals in seq; a waiter sleeps only
+// if no signal arrived after it released the mutex.
+void
+cond_init(cond_t *c)
+{
+  c->seq = 0;
+}
+
+void
+cond_wait(cond_t *c, mutex_t *m)
+{
+  uint seq;
+
+  seq = c->seq;
+  mutex_unlock(m);
+  futex_wait(&c->seq, seq);
+  mutex_lock(m);
+}
+
+void
+cond_signal(cond_t *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake(&c->seq, 1);
+}
+
+void
+cond_broadcast(cond_t *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake(&c->seq, 0x7fffffff);
+}
+
+// Run fcn(arg1, arg2) in a new thread on a one-page stack.
+// Returns the thread's pid, or -1.
+int
+thread_create(void (*fcn)(void *, void *), void *arg1, void *arg2)
+{
+  char *mem, *stack;
+  int pid;
+
+  // clone() wants a whole page; the malloc()ed block that holds
+  // it is recorded in its lowest word for thread_join().
+  if((mem = malloc(2*PGSIZE)) == 0)
+    return -1;
+  stack = (char*)PGROUNDUP((uint)mem);
+  *(char**)stack = mem;
+  if((pid = clone(fcn, arg1, arg2, stack)) < 0)
+    free(mem);
+  return pid;
+}
+
+// Wait for one of this process's threads to exit and free its
+// stack. Returns its pid, or -1 if there are no threads.
+int
+thread_join(void)
+{
+  void *stack;
+  int pid;
+
+  if((pid = join(&stack)) >= 0)
+    free(*(char**)stack);
+  return pid;
+}
@@ -0,0 +1,13 @@
+// Read-only pages that the kernel maps into every process at
+// VDSOTIME and VDSOPROC (see memlayout.h), so that user code can
+// read the time and its pid without a system call.
+
+struct vdsotime {
+  uint seq;             // odd while the kernel updates date
+  uint ticks;           // same as uptime()
+  struct rtcdate date;  // same as date(), updated once a second
+};
+
+struct vdsoproc {
+  int pid;              // same as getpid()
+};
@@ -5,10 +5,16 @@
 #include "memlayout.h"
 #include "mmu.h"
 #include "proc.h"
+#include "traps.h"
 #include "elf.h"
+#include "date.h"
+#include "vdso.h"
 
 extern char data[];  // defined by kernel.ld
 pde_t *kpgdir;  // for use in scheduler()
+struct vdsotime *vdsotime;  // mapped at VDSOTIME in every page table
+
+#define NSHRINK 32  // pages shrinkuvm() frees per TLB shootdown
 
 // Set up CPU's kernel segment descriptors.
 // Run once on entry on each CPU.
@@ -87,8 +93,10 @@ mappages(pde_t *pgdir, void *va, uint size, uint pa, int perm)
 //
 // setupkvm() and exec() set up every page table like this:
 //
-//   0..KERNBASE: user memory (text+data+stack+heap), mapped to
+//   0..USERTOP: user memory (text+data+stack+heap), mapped to
 //                phys memory allocated by the kernel
+//   VDSOTIME: read-only for user, the same page in every page table
+//   VDSOPROC: read-only for user, a page of the process's own
 //   KERNBASE..KERNBASE+EXTMEM: mapped to 0..EXTMEM (for I/O space)
 //   KERNBASE+EXTMEM..data: mapped to EXTMEM..V2P(data)
 //                for the kernel's instructions and r/o data
@@ -114,12 +122,13 @@ static struct kmap {
  { (void*)DEVSPACE, DEVSPACE,      0,         PTE_W}, // more devices
 };
 
-// Set up kernel part of a page table.
+// Set up kernel part of a page table, and the vdso.h pages.
 pde_t*
 setupkvm(void)
 {
   pde_t *pgdir;
   struct kmap *k;
+  char *mem;
 
   if((pgdir = (pde_t*)kalloc()) == 0)
     return 0;
@@ -132,9 +141,60 @@ setupkvm(void)
       freevm(pgdir);
       return 0;
     }
+  if((mem = kalloc()) == 0){
+    freevm(pgdir);
+    return 0;
+  }
+  memset(mem, 0, PGSIZE);
+  if(mappages(pgdir, (void*)VDSOPROC, PGSIZE, V2P(mem), PTE_U) < 0){
+    kfree(mem);
+    freevm(pgdir);
+    return 0;
+  }
+  if(mappages(pgdir, (void*)VDSOTIME, PGSIZE, V2P(vdsotime), PTE_U) < 0){
+    freevm(pgdir);
+    return 0;
+  }
   return pgdir;
 }
 
+// Allocate the page shared by all processes at VDSOTIME.
+// Must run before the first setupkvm().
+void
+vdsoinit(void)
+{
+  if((vdsotime = (struct vdsotime*)kalloc()) == 0)
+    panic("vdsoinit");
+  memset(vdsotime, 0, PGSIZE);
+  cmostime(&vdsotime->date);
+}
+
+// Publish the new value of ticks. cpu0 calls this on every
+// timer interrupt, and newsec is set once a second.
+void
+vdsotick(int newsec)
+{
+  vdsotime->ticks = ticks;
+  if(newsec){
+    vdsotime->seq++;  // readers retry until seq is even again
+    __sync_synchronize();
+    cmostime(&vdsotime->date);
+    __sync_synchronize();
+    vdsotime->seq++;
+  }
+}
+
+// Set the pid in pgdir's VDSOPROC page.
+void
+setvdsopid(pde_t *pgdir, int pid)
+{
+  pte_t *pte;
+
+  if((pte = walkpgdir(pgdir, (char*)VDSOPROC, 0)) == 0 || !(*pte & PTE_P))
+    panic("setvdsopid");
+  ((struct vdsoproc*)P2V(PTE_ADDR(*pte)))->pid = pid;
+}
+
 // Allocate one page table for the machine for the kernel address
 // space for scheduler processes.
 void
@@ -173,6 +233,8 @@ switchuvm(struct proc *p)
   // forbids I/O instructions (e.g., inb and outb) from user space
   mycpu()->ts.iomb = (ushort) 0xFFFF;
   ltr(SEG_TSS << 3);
+  if(sysenter)
+    wrmsr(MSR_SYSENTER_ESP, (uint)p->kstack + KSTACKSIZE);
   lcr3(V2P(p->pgdir));  // switch to process's address space
   popcli();
 }
@@ -224,7 +286,7 @@ allocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   char *mem;
   uint a;
 
-  if(newsz >= KERNBASE)
+  if(newsz >= USERTOP)
     return 0;
   if(newsz < oldsz)
     return oldsz;
@@ -278,16 +340,118 @@ deallocuvm(pde_t *pgdir, uint oldsz, uint newsz)
   return newsz;
 }
 
+// deallocuvm() for a page table other CPUs may be using, as
+// threads share one: each batch of pages is unmapped, flushed
+// from every TLB, and only then freed, so no CPU can reach a
+// page through a stale TLB entry once it is reused.
+int
+shrinkuvm(pde_t *pgdir, uint oldsz, uint newsz)
+{
+  pte_t *pte;
+  uint a, pa[NSHRINK];
+  int i, n;
+
+  if(newsz >= oldsz)
+    return oldsz;
+
+  n = 0;
+  a = PGROUNDUP(newsz);
+  for(;;){
+    if(n == NSHRINK || (n > 0 && a >= oldsz)){
+      tlbshootdown(pgdir);
+      for(i = 0; i < n; i++)
+        kfree(P2V(pa[i]));
+      n = 0;
+    }
+    if(a >= oldsz)
+      break;
+    pte = walkpgdir(pgdir, (char*)a, 0);
+    if(!pte)
+      a = PGADDR(PDX(a) + 1, 0, 0) - PGSIZE;
+    else if((*pte & PTE_P) != 0){
+      pa[n] = PTE_ADDR(*pte);
+      if(pa[n++] == 0)
+        panic("kfree");
+      *pte = 0;
+    }
+    a += PGSIZE;
+  }
+  return newsz;
+}
+
+// Flush requests from tlbshootdown(): the CPUs that have yet to
+// flush, by index in cpus[].
+static struct {
+  volatile uint busy;
+  volatile uint pending;
+} shootdown;
+
+// Flush this CPU's TLB if tlbshootdown() asked it to.
+static void
+tlbflushpending(void)
+{
+  uint me = 1 << cpuid();
+
+  if(shootdown.pending & me){
+    lcr3(rcr3());
+    __sync_fetch_and_and(&shootdown.pending, ~me);
+  }
+}
+
+// T_TLBFLUSH IPI.
+void
+tlbflushintr(void)
+{
+  tlbflushpending();
+}
+
+// Flush pgdir's user mappings from the TLB of every CPU using
+// it, after its PTEs have changed, and wait until they have.
+// The caller must hold no spin locks: CPUs spin with interrupts
+// off while they hold or wait for one, and cannot take the IPI.
+void
+tlbshootdown(pde_t *pgdir)
+{
+  struct cpu *c;
+  struct proc *p;
+  uint mask;
+
+  pushcli();
+  // Only one shootdown at a time; meanwhile flush for the
+  // one that is going on, which may be waiting for us.
+  while(xchg(&shootdown.busy, 1) != 0)
+    tlbflushpending();
+  mask = 0;
+  for(c = cpus; c < cpus+ncpu; c++)
+    if(c != mycpu() && (p = c->proc) != 0 && p->pgdir == pgdir)
+      mask |= 1 << (c - cpus);
+  // A CPU that switches to pgdir after this loads cr3, which
+  // flushes its TLB anyway.
+  shootdown.pending = mask;
+  for(c = cpus; c < cpus+ncpu; c++)
+    if(mask & (1 << (c - cpus)))
+      lapicipi(c->apicid, T_TLBFLUSH);
+  if(rcr3() == V2P(pgdir))
+    lcr3(V2P(pgdir));
+  while(shootdown.pending)
+    pause();
+  xchg(&shootdown.busy, 0);
+  popcli();
+}
+
 // Free a page table and all the physical memory pages
-// in the user part.
+// in the user part, including its VDSOPROC page.
 void
 freevm(pde_t *pgdir)
 {
   uint i;
+  pte_t *pte;
 
   if(pgdir == 0)
     panic("freevm: no pgdir");
-  deallocuvm(pgdir, KERNBASE, 0);
+  deallocuvm(pgdir, USERTOP, 0);
+  if((pte = walkpgdir(pgdir, (char*)VDSOPROC, 0)) != 0 && (*pte & PTE_P))
+    kfree(P2V(PTE_ADDR(*pte)));
   for(i = 0; i < NPDENTRIES; i++){
     if(pgdir[i] & PTE_P){
       char * v = P2V(PTE_ADDR(pgdir[i]));